@@ -0,0 +1,108 @@
+/*******************************************************************************
+*
+* FILENAME : cached_storage.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 05.12.2023
+*
+* Read cache with sequential readahead in front of another storage engine.
+*
+* Blocks are kept in an LRU cache bounded by the memory limit given on
+* construction. Writes go straight through to the underlying storage and
+* drop the cached copies of the blocks they touch.
+*
+* Reads are matched against a few recently seen streams. A read that starts
+* where a stream ended is sequential, and the stream's readahead window
+* (doubling up to the maximum) is queued for the prefetcher thread, which
+* loads it into the cache in the background. A read of a block that is being
+* prefetched waits for it instead of reading it twice.
+*
+*******************************************************************************/
+
+#ifndef NSRD_CACHED_STORAGE_HPP
+#define NSRD_CACHED_STORAGE_HPP
+
+#include <cstddef> // std::size_t
+#include <memory> // std::unique_ptr
+#include <vector> // std::vector
+#include <list> // std::list
+#include <deque> // std::deque
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+
+#include "storage.hpp" // nsrd::IStorage
+
+namespace nsrd
+{
+class CachedStorage : public IStorage
+{
+public:
+    static const std::size_t BLOCK_SIZE = 4096;
+    static const std::size_t DEFAULT_READAHEAD_MAX = 1024 * 1024;
+
+    // readahead never takes more than a quarter of cache_size
+    explicit CachedStorage(std::unique_ptr<IStorage> storage, std::size_t cache_size,
+                           std::size_t readahead_max = DEFAULT_READAHEAD_MAX);
+    ~CachedStorage() noexcept;
+
+    bool Read(void *buf, std::size_t len, std::size_t offset);
+    bool Write(const void *buf, std::size_t len, std::size_t offset);
+    bool Flush();
+
+    CachedStorage(const CachedStorage &) =delete;
+    CachedStorage(const CachedStorage &&) =delete;
+    CachedStorage &operator=(const CachedStorage &) =delete;
+    CachedStorage &operator=(const CachedStorage &&) =delete;
+
+private:
+    struct Block
+    {
+        std::size_t m_idx;
+        std::vector<char> m_data;
+    };
+
+    struct Stream
+    {
+        std::size_t m_next_offset;
+        std::size_t m_window;
+        std::size_t m_prefetched_until;
+    };
+
+    struct Range
+    {
+        std::size_t m_first_block;
+        std::size_t m_blocks;
+    };
+
+    std::unique_ptr<IStorage> m_storage;
+    std::size_t m_capacity; // in blocks
+    std::size_t m_readahead_max; // in bytes
+    std::list<Block> m_lru; // most recently used first
+    std::unordered_map<std::size_t, std::list<Block>::iterator> m_blocks;
+    std::unordered_set<std::size_t> m_in_flight;
+    std::size_t m_write_epoch;
+    std::vector<Stream> m_streams;
+    std::size_t m_next_stream;
+    std::deque<Range> m_prefetch_queue;
+
+    std::mutex m_mutex;
+    std::condition_variable m_prefetch_cond;
+    std::condition_variable m_prefetched_cond;
+    bool m_run;
+    std::thread m_prefetcher;
+
+    bool CopyCached(std::size_t block_idx, char *dest, std::size_t from, std::size_t len);
+    void Insert(std::size_t block_idx, const char *data);
+    void Invalidate(std::size_t first_block, std::size_t last_block);
+    bool LoadBlocks(std::unique_lock<std::mutex> &lock, std::size_t first_block,
+                    std::size_t blocks, char *dest);
+    void DetectStream(std::size_t offset, std::size_t len);
+    void Prefetcher();
+};
+} // namespace nsrd
+
+#endif // NSRD_CACHED_STORAGE_HPP
@@ -0,0 +1,59 @@
+/*******************************************************************************
+*
+* FILENAME : group_commit.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 04.12.2023
+*
+* Coalesces flush requests into as few storage flushes as possible.
+*
+* RequestFlush only queues the request and returns. A committer thread takes
+* every request queued so far, flushes the storage once for all of them and
+* then calls their callbacks with the flush status. Requests that arrive while
+* a flush is in progress are served together by the next one.
+*
+*******************************************************************************/
+
+#ifndef NSRD_GROUP_COMMIT_HPP
+#define NSRD_GROUP_COMMIT_HPP
+
+#include <functional> // std::function
+#include <vector> // std::vector
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+
+#include "storage.hpp" // nsrd::IStorage
+
+namespace nsrd
+{
+class GroupCommit
+{
+public:
+    typedef std::function<void(bool status)> callback_t;
+
+    explicit GroupCommit(IStorage &storage);
+    ~GroupCommit() noexcept;
+
+    GroupCommit(const GroupCommit &) =delete;
+    GroupCommit(const GroupCommit &&) =delete;
+    GroupCommit &operator=(const GroupCommit &) =delete;
+    GroupCommit &operator=(const GroupCommit &&) =delete;
+
+    // callback is called from the committer thread
+    void RequestFlush(const callback_t &callback);
+
+private:
+    IStorage &m_storage;
+    std::vector<callback_t> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_has_pending;
+    bool m_run;
+    std::thread m_committer;
+
+    void Committer();
+};
+} // namespace nsrd
+
+#endif // NSRD_GROUP_COMMIT_HPP
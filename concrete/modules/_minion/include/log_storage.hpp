@@ -0,0 +1,129 @@
+/*******************************************************************************
+*
+* FILENAME : log_storage.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 02.12.2023
+*
+* Log-structured storage engine for flash media (SD cards, eMMC) that handle
+* random writes badly.
+*
+* Every write is appended as a sequence of block records to the tail of the
+* active segment file, so the media only ever sees sequential writes.
+* An in-memory index maps each block of the device to the record holding its
+* latest version and reads are served through it. Once the active segment is
+* full it gets sealed and a new one is opened. A background compactor copies
+* the live records of mostly-overwritten sealed segments to the log tail and
+* deletes the old segment files.
+*
+* Each record carries a checksum of its header and data. On construction the
+* index is rebuilt by replaying the existing segments; a segment's replay
+* stops at the first record failing its checksum, e.g. one torn by a crash,
+* and the segment's tail is put there, so an older copy of the block stays
+* the latest one.
+* Flush syncs only the segments written since the previous flush. Flushes
+* run one at a time, so one finding nothing left to sync returns only once
+* the data an earlier one took over is durable; the segments it fails to
+* sync stay dirty for the next one.
+*
+*******************************************************************************/
+
+#ifndef NSRD_LOG_STORAGE_HPP
+#define NSRD_LOG_STORAGE_HPP
+
+#include <cstddef> // std::size_t
+#include <string> // std::string
+#include <vector> // std::vector
+#include <map> // std::map
+#include <unordered_map> // std::unordered_map
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+
+#include "storage.hpp" // nsrd::IStorage
+
+namespace nsrd
+{
+class LogStorage : public IStorage
+{
+public:
+    static const std::size_t BLOCK_SIZE = 4096;
+    static const std::size_t DEFAULT_SEGMENT_SIZE = 16 * 1024 * 1024;
+
+    explicit LogStorage(const std::string &path_prefix,
+                        std::size_t segment_size = DEFAULT_SEGMENT_SIZE);
+    ~LogStorage() noexcept;
+
+    bool Read(void *buf, std::size_t len, std::size_t offset);
+    bool Write(const void *buf, std::size_t len, std::size_t offset);
+    bool Flush();
+
+    LogStorage(const LogStorage &) =delete;
+    LogStorage(const LogStorage &&) =delete;
+    LogStorage &operator=(const LogStorage &) =delete;
+    LogStorage &operator=(const LogStorage &&) =delete;
+
+private:
+    struct RecordHeader
+    {
+        unsigned m_magic;
+        unsigned m_checksum; // CRC-32 of the header, with this field 0, and the data
+        std::size_t m_block_idx;
+        std::size_t m_seq;
+    };
+
+    static const std::size_t RECORD_SIZE = sizeof(RecordHeader) + BLOCK_SIZE;
+
+    struct Location
+    {
+        std::size_t m_segment_id;
+        std::size_t m_record_offset;
+        std::size_t m_seq;
+    };
+
+    struct Segment
+    {
+        int m_fd;
+        std::size_t m_tail;
+        std::size_t m_live_records;
+        bool m_dirty;
+    };
+
+    std::string m_path_prefix;
+    std::size_t m_segment_capacity;
+    std::unordered_map<std::size_t, Location> m_index;
+    std::map<std::size_t, Segment> m_segments;
+    std::size_t m_active_segment_id;
+    std::size_t m_seq_counter;
+    std::vector<char> m_staging;
+    bool m_dir_dirty;
+    Logger *m_logger;
+
+    std::mutex m_mutex;
+    std::mutex m_flush_mutex; // held through a whole Flush, taken before m_mutex
+    std::condition_variable m_compact_cond;
+    bool m_run;
+    std::thread m_compactor;
+
+    static unsigned Checksum(const RecordHeader &header, const char *data);
+
+    void Recover();
+    bool SyncDir();
+    void ReplaySegment(std::size_t segment_id);
+    std::string SegmentName(std::size_t segment_id) const;
+    void OpenSegment(std::size_t segment_id);
+    void RollSegment();
+
+    bool ReadBlock(std::size_t block_idx, char *dest);
+    bool StageBlock(std::size_t block_idx, const char *data);
+    bool FlushStaging();
+    void UpdateIndex(std::size_t block_idx, const Location &location);
+
+    void Compactor();
+    bool PickVictim(std::size_t &victim_id);
+    bool Compact(std::unique_lock<std::mutex> &lock, std::size_t victim_id);
+};
+} // namespace nsrd
+
+#endif // NSRD_LOG_STORAGE_HPP
\ No newline at end of file
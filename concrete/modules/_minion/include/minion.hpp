@@ -17,6 +17,10 @@
 #include <thread> // std::thread
 #include <mutex> // std::timed_mutex
 #include <memory> // std::shared_ptr
+#include <map> // std::map
+#include <deque> // std::deque
+#include <vector> // std::vector
+#include <chrono> // std::chrono::steady_clock
 
 #include <iostream>
 #include <netinet/in.h>
@@ -28,43 +32,104 @@
 
 #include "logger.hpp" // nsrd::Logger
 #include "reactor.hpp" // nsrd::Reactor
+#include "thread_pool.hpp" // nsrd::ThreadPool
 
 #include "minion_event.hpp" // nsrd::MinionEventType, nsrd::MinionEvent
+#include "storage.hpp" // nsrd::IStorage
+#include "group_commit.hpp" // nsrd::GroupCommit
 
 namespace nsrd
 {
+/*
+    Minion serves any number of proxies at the same time.
+    Each (source address, session id) pair gets its own session with
+    an independent request queue. Requests of one session are executed
+    in order, different sessions are executed in parallel by the workers.
+*/
 class Minion
 {
 public:
-    explicit Minion(unsigned short port, std::size_t storage_size);
+    /*
+        DIRECT_STORAGE writes blocks in place into a single file.
+        LOG_STORAGE appends writes to a segment log (see log_storage.hpp),
+        which suits SD cards and eMMC better.
+    */
+    enum StorageType {DIRECT_STORAGE = 0, LOG_STORAGE};
+
+    // reads are served through a cache of cache_size bytes, 0 disables it
+    static const std::size_t DEFAULT_CACHE_SIZE = 16 * 1024 * 1024;
+    static const std::chrono::minutes SESSION_IDLE_TIMEOUT;
+
+    explicit Minion(unsigned short port, std::size_t storage_size,
+                    StorageType storage_type = DIRECT_STORAGE,
+                    std::size_t cache_size = DEFAULT_CACHE_SIZE);
     ~Minion();
     void Run();
     void Stop();
 
 private:
-    enum PIPE_PAIR {READ_END = 0, WRITE_END, PIPE_PAIR};
+    struct SessionKey
+    {
+        in_addr_t m_addr;
+        in_port_t m_port;
+        std::size_t m_session_id;
+
+        bool operator<(const SessionKey &other) const;
+    };
+
+    struct Request
+    {
+        MinionEvent m_event;
+        std::vector<char> m_data;
+    };
+
+    struct Session
+    {
+        sockaddr m_peer_sa;
+        std::deque<Request> m_requests;
+        bool m_is_served;
+        std::chrono::steady_clock::time_point m_last_request; // by the reactor thread
+        std::mutex m_requests_mutex;
+        std::mutex m_send_mutex;
+    };
+
+    // WRITE whose payload datagrams are still arriving
+    struct IncomingWrite
+    {
+        std::shared_ptr<Session> m_session;
+        Request m_request;
+        std::size_t m_received;
+        std::chrono::steady_clock::time_point m_last_datagram;
+    };
+
+    class ServeTask;
 
     unsigned short m_minion_port;
     int m_minion_socket;
-    sockaddr m_proxy_sa;
-    socklen_t m_proxy_sa_len;
-    int m_storage_file;
+    std::unique_ptr<IStorage> m_storage;
+    std::unique_ptr<GroupCommit> m_group_commit;
+    std::map<SessionKey, std::shared_ptr<Session> > m_sessions;
+    std::map<SessionKey, IncomingWrite> m_incoming; // keyed by peer address only
     bool m_run;
-    int m_stop_reactor_pipe[PIPE_PAIR];
     Logger *m_logger;
+    std::unique_ptr<ThreadPool> m_workers;
     Reactor m_reactor;
 
     void OpenSocket();
-    void AcceptProxyConnection();
-    void ReadConnectionRequest(MinionEvent *event);
     void InputMediator();
-    void StopReactorHandler();
-    void Write(const MinionEvent &request);
-    void Read(const MinionEvent &request);
-    bool SendData(void *buf, std::size_t length);
-    bool ReadData(void *buf, std::size_t length);
-    void StorageRead(void *buf, unsigned len, std::size_t offset);
-    void StorageWrite(void *buf, unsigned len, std::size_t offset);
+    bool ReceivePayload(const SessionKey &peer, const char *buf, std::size_t length);
+    void HandleRequest(const sockaddr &from_sa, const MinionEvent &request);
+    void DropOtherSessions(const SessionKey &key);
+    void ExpireSessions();
+    void Enqueue(const std::shared_ptr<Session> &session, const Request &request);
+    void Serve(const std::shared_ptr<Session> &session);
+    void Write(const std::shared_ptr<Session> &session, const Request &request);
+    void Read(const std::shared_ptr<Session> &session, const Request &request);
+    void Flush(const std::shared_ptr<Session> &session, const Request &request);
+    void FlushDone(const std::shared_ptr<Session> &session, const MinionEvent &request, bool status);
+    void Respond(const std::shared_ptr<Session> &session, const MinionEvent &request, bool status);
+    bool SendResponse(Session &session, const MinionEvent &response, const void *buf = nullptr);
+    bool SendReply(const sockaddr &to_sa, const MinionEvent &response, const char *data, std::size_t length);
 };
 }
 
@@ -0,0 +1,59 @@
+/*******************************************************************************
+*
+* FILENAME : storage.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 02.12.2023
+*
+*******************************************************************************/
+
+#ifndef NSRD_STORAGE_HPP
+#define NSRD_STORAGE_HPP
+
+#include <cstddef> // std::size_t
+#include <string> // std::string
+
+#include "logger.hpp" // nsrd::Logger
+
+namespace nsrd
+{
+/*
+    Storage engine the minion keeps its blocks in.
+    Read of a range that was never written fills the buffer with zeroes.
+    Write may leave the data buffered, it is durable only after Flush returns.
+*/
+class IStorage
+{
+public:
+    virtual ~IStorage() =0;
+    virtual bool Read(void *buf, std::size_t len, std::size_t offset) =0;
+    virtual bool Write(const void *buf, std::size_t len, std::size_t offset) =0;
+    virtual bool Flush() =0;
+};
+
+/*
+    Writes blocks in place into a single file.
+*/
+class FileStorage : public IStorage
+{
+public:
+    explicit FileStorage(const std::string &file_name);
+    ~FileStorage() noexcept;
+
+    bool Read(void *buf, std::size_t len, std::size_t offset);
+    bool Write(const void *buf, std::size_t len, std::size_t offset);
+    bool Flush();
+
+    FileStorage(const FileStorage &) =delete;
+    FileStorage(const FileStorage &&) =delete;
+    FileStorage &operator=(const FileStorage &) =delete;
+    FileStorage &operator=(const FileStorage &&) =delete;
+
+private:
+    int m_storage_file;
+    Logger *m_logger;
+};
+} // namespace nsrd
+
+#endif // NSRD_STORAGE_HPP
\ No newline at end of file
@@ -26,8 +26,12 @@
 using namespace nsrd;
 namespace
 {
-enum MINION_ARG {PORT = 1, STORAGE_SIZE, MINION_ARGS};
+enum MINION_ARG {PORT = 1, STORAGE_SIZE, STORAGE_TYPE, CACHE_SIZE, MINION_ARGS};
+const std::string LOG_STORAGE_ARG("log");
+const std::size_t MIB = 1024 * 1024;
 void ValidateArguments(int argc, char const *argv[]);
+Minion::StorageType GetStorageType(int argc, char const *argv[]);
+std::size_t GetCacheSize(int argc, char const *argv[]);
 void Demonize();
 }
 
@@ -37,7 +41,8 @@ int main(int argc, char const *argv[])
 
     Demonize();
 
-    Minion minion(std::stoul(argv[PORT]), std::stoul(argv[STORAGE_SIZE]));
+    Minion minion(std::stoul(argv[PORT]), std::stoul(argv[STORAGE_SIZE]),
+                  GetStorageType(argc, argv), GetCacheSize(argc, argv));
     minion.Run();
 
     return (EXIT_SUCCESS);
@@ -47,21 +52,43 @@ namespace
 {
 void ValidateArguments(int argc, char const *argv[])
 {
-    if (MINION_ARGS != argc || !argv[PORT] || !argv[STORAGE_SIZE])
+    if (STORAGE_TYPE > argc || MINION_ARGS < argc || !argv[PORT] || !argv[STORAGE_SIZE])
     {
         std::cout
         << RED
         << "You must provide neccessary arguments\n"
         << "1: minion port\n"
         << "2: minion size\n"
+        << "3 (optional): storage type, 'direct' (default) or 'log'\n"
+        << "4 (optional): read cache size in MiB, 0 disables it (default 16)\n"
         << "example:\n"
-        << "./minion_daemon_aarch64.out 1501 128"
+        << "./minion_daemon_aarch64.out 1501 128 log 4"
         << NC << std::endl;
 
         exit(EXIT_FAILURE);
     }
 }
 
+Minion::StorageType GetStorageType(int argc, char const *argv[])
+{
+    if (STORAGE_TYPE < argc && LOG_STORAGE_ARG == argv[STORAGE_TYPE])
+    {
+        return (Minion::LOG_STORAGE);
+    }
+
+    return (Minion::DIRECT_STORAGE);
+}
+
+std::size_t GetCacheSize(int argc, char const *argv[])
+{
+    if (CACHE_SIZE < argc)
+    {
+        return (std::stoul(argv[CACHE_SIZE]) * MIB);
+    }
+
+    return (Minion::DEFAULT_CACHE_SIZE);
+}
+
 void Demonize()
 {
     pid_t pid;
@@ -0,0 +1,315 @@
+/*******************************************************************************
+*
+* FILENAME : cached_storage.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 05.12.2023
+*
+*******************************************************************************/
+
+#include <cstring> // std::memcpy
+#include <algorithm> // std::min, std::max
+#include <iterator> // std::prev
+#include <utility> // std::move
+
+#include "cached_storage.hpp" // nsrd::CachedStorage
+
+using namespace nsrd;
+
+namespace
+{
+const std::size_t MAX_STREAMS = 8;
+const std::size_t NO_STREAM = static_cast<std::size_t>(-1);
+const std::size_t MAX_PENDING_PREFETCHES = 16;
+const std::size_t PREFETCH_CHUNK_BLOCKS = 32;
+} // namespace
+
+const std::size_t CachedStorage::BLOCK_SIZE;
+const std::size_t CachedStorage::DEFAULT_READAHEAD_MAX;
+
+CachedStorage::CachedStorage(std::unique_ptr<IStorage> storage, std::size_t cache_size,
+                             std::size_t readahead_max)
+    : m_storage(std::move(storage)),
+      m_capacity(cache_size / BLOCK_SIZE),
+      m_readahead_max(std::min(readahead_max, cache_size / 4) / BLOCK_SIZE * BLOCK_SIZE),
+      m_lru(),
+      m_blocks(),
+      m_in_flight(),
+      m_write_epoch(0),
+      m_streams(MAX_STREAMS, Stream({NO_STREAM, 0, 0})),
+      m_next_stream(0),
+      m_prefetch_queue(),
+      m_mutex(),
+      m_prefetch_cond(),
+      m_prefetched_cond(),
+      m_run(true),
+      m_prefetcher()
+{
+    m_prefetcher = std::thread(&CachedStorage::Prefetcher, this);
+}
+
+CachedStorage::~CachedStorage() noexcept
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_run = false;
+    }
+    m_prefetch_cond.notify_one();
+    m_prefetcher.join();
+}
+
+bool CachedStorage::Read(void *buf, std::size_t len, std::size_t offset)
+{
+    if (0 == len)
+    {
+        return (true);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    DetectStream(offset, len);
+
+    char *buffer = static_cast<char *>(buf);
+    std::size_t block_idx = offset / BLOCK_SIZE;
+    std::size_t last_block = (offset + len - 1) / BLOCK_SIZE;
+    std::size_t from = offset % BLOCK_SIZE;
+
+    while (block_idx <= last_block)
+    {
+        if (m_in_flight.count(block_idx))
+        {
+            m_prefetched_cond.wait(lock);
+            continue;
+        }
+
+        std::size_t to_copy = std::min(BLOCK_SIZE - from, len);
+
+        if (CopyCached(block_idx, buffer, from, to_copy))
+        {
+            buffer += to_copy;
+            len -= to_copy;
+            from = 0;
+            ++block_idx;
+            continue;
+        }
+
+        std::size_t blocks = 1;
+        while (block_idx + blocks <= last_block
+            && !m_blocks.count(block_idx + blocks)
+            && !m_in_flight.count(block_idx + blocks))
+        {
+            ++blocks;
+        }
+
+        std::vector<char> loaded(blocks * BLOCK_SIZE);
+        if (!LoadBlocks(lock, block_idx, blocks, loaded.data()))
+        {
+            return (false);
+        }
+
+        to_copy = std::min(blocks * BLOCK_SIZE - from, len);
+        std::memcpy(buffer, loaded.data() + from, to_copy);
+
+        buffer += to_copy;
+        len -= to_copy;
+        from = 0;
+        block_idx += blocks;
+    }
+
+    return (true);
+}
+
+bool CachedStorage::Write(const void *buf, std::size_t len, std::size_t offset)
+{
+    bool status = m_storage->Write(buf, len, offset);
+
+    if (0 < len)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Invalidate(offset / BLOCK_SIZE, (offset + len - 1) / BLOCK_SIZE);
+        ++m_write_epoch;
+    }
+
+    return (status);
+}
+
+bool CachedStorage::Flush()
+{
+    return (m_storage->Flush());
+}
+
+bool CachedStorage::CopyCached(std::size_t block_idx, char *dest, std::size_t from, std::size_t len)
+{
+    auto found = m_blocks.find(block_idx);
+    if (m_blocks.end() == found)
+    {
+        return (false);
+    }
+
+    std::memcpy(dest, found->second->m_data.data() + from, len);
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+
+    return (true);
+}
+
+void CachedStorage::Insert(std::size_t block_idx, const char *data)
+{
+    auto found = m_blocks.find(block_idx);
+    if (m_blocks.end() != found)
+    {
+        std::memcpy(found->second->m_data.data(), data, BLOCK_SIZE);
+        m_lru.splice(m_lru.begin(), m_lru, found->second);
+        return;
+    }
+
+    if (0 == m_capacity)
+    {
+        return;
+    }
+
+    if (m_lru.size() < m_capacity)
+    {
+        m_lru.push_front(Block({block_idx, std::vector<char>(BLOCK_SIZE)}));
+    }
+    else
+    {
+        // reuse the least recently used block
+        m_blocks.erase(m_lru.back().m_idx);
+        m_lru.splice(m_lru.begin(), m_lru, std::prev(m_lru.end()));
+        m_lru.front().m_idx = block_idx;
+    }
+
+    std::memcpy(m_lru.front().m_data.data(), data, BLOCK_SIZE);
+    m_blocks[block_idx] = m_lru.begin();
+}
+
+void CachedStorage::Invalidate(std::size_t first_block, std::size_t last_block)
+{
+    for (std::size_t block_idx = first_block; block_idx <= last_block; ++block_idx)
+    {
+        auto found = m_blocks.find(block_idx);
+        if (m_blocks.end() != found)
+        {
+            m_lru.erase(found->second);
+            m_blocks.erase(found);
+        }
+    }
+}
+
+bool CachedStorage::LoadBlocks(std::unique_lock<std::mutex> &lock, std::size_t first_block,
+                               std::size_t blocks, char *dest)
+{
+    for (std::size_t i = 0; i < blocks; ++i)
+    {
+        m_in_flight.insert(first_block + i);
+    }
+
+    std::size_t epoch = m_write_epoch;
+
+    lock.unlock();
+    bool status = m_storage->Read(dest, blocks * BLOCK_SIZE, first_block * BLOCK_SIZE);
+    lock.lock();
+
+    // a write that raced with the load might have made the data stale
+    bool should_cache = status && epoch == m_write_epoch;
+
+    for (std::size_t i = 0; i < blocks; ++i)
+    {
+        m_in_flight.erase(first_block + i);
+
+        if (should_cache)
+        {
+            Insert(first_block + i, dest + i * BLOCK_SIZE);
+        }
+    }
+
+    m_prefetched_cond.notify_all();
+
+    return (status);
+}
+
+void CachedStorage::DetectStream(std::size_t offset, std::size_t len)
+{
+    if (BLOCK_SIZE > m_readahead_max)
+    {
+        return;
+    }
+
+    for (auto &stream : m_streams)
+    {
+        if (stream.m_next_offset != offset)
+        {
+            continue;
+        }
+
+        stream.m_next_offset = offset + len;
+        stream.m_window = std::min(stream.m_window * 2, m_readahead_max);
+        stream.m_prefetched_until = std::max(stream.m_prefetched_until, stream.m_next_offset);
+
+        // keep at least half a window ahead of the reader
+        if (stream.m_prefetched_until - stream.m_next_offset > stream.m_window / 2
+         || MAX_PENDING_PREFETCHES <= m_prefetch_queue.size())
+        {
+            return;
+        }
+
+        std::size_t first_block = stream.m_prefetched_until / BLOCK_SIZE;
+        std::size_t end_block = (stream.m_next_offset + stream.m_window + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        m_prefetch_queue.push_back(Range({first_block, end_block - first_block}));
+        stream.m_prefetched_until = end_block * BLOCK_SIZE;
+        m_prefetch_cond.notify_one();
+
+        return;
+    }
+
+    std::size_t window = std::max(std::min(len * 2, m_readahead_max), BLOCK_SIZE);
+    m_streams[m_next_stream] = Stream({offset + len, window, offset + len});
+    m_next_stream = (m_next_stream + 1) % MAX_STREAMS;
+}
+
+void CachedStorage::Prefetcher()
+{
+    std::vector<char> buffer(PREFETCH_CHUNK_BLOCKS * BLOCK_SIZE);
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_run)
+    {
+        if (m_prefetch_queue.empty())
+        {
+            m_prefetch_cond.wait(lock);
+            continue;
+        }
+
+        Range range = m_prefetch_queue.front();
+        m_prefetch_queue.pop_front();
+
+        std::size_t block_idx = range.m_first_block;
+        std::size_t end_block = range.m_first_block + range.m_blocks;
+
+        while (m_run && block_idx < end_block)
+        {
+            if (m_blocks.count(block_idx) || m_in_flight.count(block_idx))
+            {
+                ++block_idx;
+                continue;
+            }
+
+            std::size_t blocks = 1;
+            while (block_idx + blocks < end_block && PREFETCH_CHUNK_BLOCKS > blocks
+                && !m_blocks.count(block_idx + blocks)
+                && !m_in_flight.count(block_idx + blocks))
+            {
+                ++blocks;
+            }
+
+            if (!LoadBlocks(lock, block_idx, blocks, buffer.data()))
+            {
+                break;
+            }
+
+            block_idx += blocks;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*******************************************************************************
+*
+* FILENAME : group_commit.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 04.12.2023
+*
+*******************************************************************************/
+
+#include "group_commit.hpp" // nsrd::GroupCommit
+
+using namespace nsrd;
+
+GroupCommit::GroupCommit(IStorage &storage)
+    : m_storage(storage),
+      m_pending(),
+      m_mutex(),
+      m_has_pending(),
+      m_run(true),
+      m_committer()
+{
+    m_committer = std::thread(&GroupCommit::Committer, this);
+}
+
+GroupCommit::~GroupCommit() noexcept
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_run = false;
+    }
+    m_has_pending.notify_one();
+    m_committer.join();
+}
+
+void GroupCommit::RequestFlush(const callback_t &callback)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pending.push_back(callback);
+    }
+    m_has_pending.notify_one();
+}
+
+void GroupCommit::Committer()
+{
+    std::vector<callback_t> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_run || !m_pending.empty())
+    {
+        if (m_pending.empty())
+        {
+            m_has_pending.wait(lock);
+            continue;
+        }
+
+        batch.swap(m_pending);
+        lock.unlock();
+
+        bool status = m_storage.Flush();
+        for (auto &callback : batch)
+        {
+            callback(status);
+        }
+        batch.clear();
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,646 @@
+/*******************************************************************************
+*
+* FILENAME : log_storage.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 02.12.2023
+*
+*******************************************************************************/
+
+#include <fcntl.h> // open
+#include <unistd.h> // pread, pwrite, fdatasync, fsync, dup, close, unlink
+#include <dirent.h> // opendir, readdir, closedir
+#include <cerrno> // errno
+#include <cstring> // std::strerror, std::memset, std::memcpy
+#include <cstdlib> // std::strtoul
+#include <algorithm> // std::sort, std::min
+#include <stdexcept> // std::runtime_error
+#include <utility> // std::pair
+
+#include "log_storage.hpp" // nsrd::LogStorage
+
+using namespace nsrd;
+
+namespace
+{
+const unsigned RECORD_MAGIC = 0x10C5E6;
+const std::string SEGMENT_SUFFIX(".seg.");
+const double COMPACT_LIVE_RATIO = 0.5;
+const std::size_t COMPACT_CHUNK_RECORDS = 64;
+
+// CRC-32 (IEEE), continuing from the crc of the preceding bytes
+unsigned Crc32(unsigned crc, const char *data, std::size_t len);
+std::vector<unsigned> MakeCrc32Table();
+bool PreadAll(int fd, char *buf, std::size_t len, std::size_t offset);
+bool PwriteAll(int fd, const char *buf, std::size_t len, std::size_t offset);
+std::string DirName(const std::string &path_prefix);
+std::vector<std::size_t> ListSegments(const std::string &path_prefix);
+} // namespace
+
+const std::size_t LogStorage::BLOCK_SIZE;
+const std::size_t LogStorage::DEFAULT_SEGMENT_SIZE;
+const std::size_t LogStorage::RECORD_SIZE;
+
+LogStorage::LogStorage(const std::string &path_prefix, std::size_t segment_size)
+    : m_path_prefix(path_prefix),
+      m_segment_capacity(std::max(segment_size / RECORD_SIZE, std::size_t(1))),
+      m_index(),
+      m_segments(),
+      m_active_segment_id(0),
+      m_seq_counter(0),
+      m_staging(),
+      m_dir_dirty(false),
+      m_logger(Handleton<Logger>::GetInstance()),
+      m_mutex(),
+      m_flush_mutex(),
+      m_compact_cond(),
+      m_run(true),
+      m_compactor()
+{
+    Recover();
+    m_compactor = std::thread(&LogStorage::Compactor, this);
+}
+
+LogStorage::~LogStorage() noexcept
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_run = false;
+    }
+    m_compact_cond.notify_one();
+    m_compactor.join();
+
+    for (auto &segment : m_segments)
+    {
+        close(segment.second.m_fd);
+    }
+}
+
+bool LogStorage::Read(void *buf, std::size_t len, std::size_t offset)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    char *buffer = static_cast<char *>(buf);
+    char block[BLOCK_SIZE];
+
+    while (0 < len)
+    {
+        std::size_t block_idx = offset / BLOCK_SIZE;
+        std::size_t block_offset = offset % BLOCK_SIZE;
+        std::size_t chunk = std::min(BLOCK_SIZE - block_offset, len);
+
+        if (BLOCK_SIZE == chunk)
+        {
+            if (!ReadBlock(block_idx, buffer))
+            {
+                return (false);
+            }
+        }
+        else
+        {
+            if (!ReadBlock(block_idx, block))
+            {
+                return (false);
+            }
+            std::memcpy(buffer, block + block_offset, chunk);
+        }
+
+        buffer += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+
+    return (true);
+}
+
+bool LogStorage::Write(const void *buf, std::size_t len, std::size_t offset)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    const char *buffer = static_cast<const char *>(buf);
+    char block[BLOCK_SIZE];
+
+    while (0 < len)
+    {
+        std::size_t block_idx = offset / BLOCK_SIZE;
+        std::size_t block_offset = offset % BLOCK_SIZE;
+        std::size_t chunk = std::min(BLOCK_SIZE - block_offset, len);
+        const char *data = buffer;
+
+        if (BLOCK_SIZE != chunk)
+        {
+            if (!ReadBlock(block_idx, block))
+            {
+                return (false);
+            }
+            std::memcpy(block + block_offset, buffer, chunk);
+            data = block;
+        }
+
+        if (!StageBlock(block_idx, data))
+        {
+            return (false);
+        }
+
+        buffer += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+
+    return (FlushStaging());
+}
+
+bool LogStorage::Flush()
+{
+    std::unique_lock<std::mutex> flush_lock(m_flush_mutex);
+
+    std::vector<std::pair<std::size_t, int> > dirty_fds; // by segment id
+    bool sync_dir = false;
+    bool status = true;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (auto &segment : m_segments)
+        {
+            if (segment.second.m_dirty)
+            {
+                int fd = dup(segment.second.m_fd);
+                if (-1 == fd)
+                {
+                    m_logger->Error(std::string("[MINION] LogStorage, dup(), ") + std::strerror(errno));
+                    status = false;
+                    continue;
+                }
+
+                dirty_fds.push_back({segment.first, fd});
+                segment.second.m_dirty = false;
+            }
+        }
+
+        sync_dir = m_dir_dirty;
+        m_dir_dirty = false;
+    }
+
+    std::vector<std::size_t> failed_ids;
+
+    for (const auto &dirty_fd : dirty_fds)
+    {
+        if (-1 == fdatasync(dirty_fd.second))
+        {
+            m_logger->Error(std::string("[MINION] LogStorage, fdatasync(), ") + std::strerror(errno));
+            failed_ids.push_back(dirty_fd.first);
+        }
+
+        close(dirty_fd.second);
+    }
+
+    bool dir_failed = sync_dir && !SyncDir();
+
+    if (!failed_ids.empty() || dir_failed)
+    {
+        // left for the next flush to retry
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (std::size_t segment_id : failed_ids)
+        {
+            auto found = m_segments.find(segment_id);
+            if (found != m_segments.end())
+            {
+                found->second.m_dirty = true;
+            }
+        }
+
+        m_dir_dirty = m_dir_dirty || dir_failed;
+        status = false;
+    }
+
+    return (status);
+}
+
+/* Segments */
+/* ************************************************************************** */
+
+void LogStorage::Recover()
+{
+    std::vector<std::size_t> segment_ids = ListSegments(m_path_prefix);
+
+    for (std::size_t segment_id : segment_ids)
+    {
+        OpenSegment(segment_id);
+        ReplaySegment(segment_id);
+    }
+
+    if (segment_ids.empty())
+    {
+        OpenSegment(0);
+        return;
+    }
+
+    m_active_segment_id = segment_ids.back();
+
+    if (m_segment_capacity * RECORD_SIZE <= m_segments[m_active_segment_id].m_tail)
+    {
+        RollSegment();
+    }
+
+    m_logger->Info("[MINION] LOG STORAGE RECOVERED " + std::to_string(m_index.size()) + " BLOCKS");
+}
+
+void LogStorage::ReplaySegment(std::size_t segment_id)
+{
+    Segment &segment = m_segments[segment_id];
+    std::vector<char> record(RECORD_SIZE);
+    const RecordHeader *header = reinterpret_cast<const RecordHeader *>(record.data());
+    std::size_t record_offset = 0;
+
+    for (std::size_t i = 0; i < m_segment_capacity; ++i, record_offset += RECORD_SIZE)
+    {
+        if (!PreadAll(segment.m_fd, record.data(), RECORD_SIZE, record_offset)
+         || RECORD_MAGIC != header->m_magic)
+        {
+            break;
+        }
+
+        if (header->m_checksum != Checksum(*header, record.data() + sizeof(RecordHeader)))
+        {
+            m_logger->Warn("[MINION] LOG STORAGE DISCARDS A TORN RECORD IN SEGMENT " +
+                           std::to_string(segment_id));
+            break;
+        }
+
+        auto found = m_index.find(header->m_block_idx);
+        if (found == m_index.end() || found->second.m_seq < header->m_seq)
+        {
+            UpdateIndex(header->m_block_idx, Location{segment_id, record_offset, header->m_seq});
+        }
+
+        m_seq_counter = std::max(m_seq_counter, header->m_seq + 1);
+    }
+
+    segment.m_tail = record_offset;
+}
+
+std::string LogStorage::SegmentName(std::size_t segment_id) const
+{
+    return (m_path_prefix + SEGMENT_SUFFIX + std::to_string(segment_id));
+}
+
+void LogStorage::OpenSegment(std::size_t segment_id)
+{
+    int fd = open(SegmentName(segment_id).c_str(), O_CREAT | O_RDWR, 0666);
+    if (-1 == fd)
+    {
+        m_logger->Error(std::string("[MINION] LogStorage, open(), ") + std::strerror(errno));
+        throw std::runtime_error("[MINION] COULDN'T OPEN LOG SEGMENT");
+    }
+
+    m_segments[segment_id] = Segment{fd, 0, 0, false};
+    m_active_segment_id = segment_id;
+    m_dir_dirty = true;
+}
+
+bool LogStorage::SyncDir()
+{
+    int dir_fd = open(DirName(m_path_prefix).c_str(), O_RDONLY | O_DIRECTORY);
+    bool status = -1 != dir_fd && -1 != fsync(dir_fd);
+
+    if (!status)
+    {
+        m_logger->Error(std::string("[MINION] LogStorage, fsync() on directory, ") + std::strerror(errno));
+    }
+
+    if (-1 != dir_fd)
+    {
+        close(dir_fd);
+    }
+
+    return (status);
+}
+
+void LogStorage::RollSegment()
+{
+    OpenSegment(m_segments.rbegin()->first + 1);
+    m_compact_cond.notify_one();
+}
+
+/* Blocks */
+/* ************************************************************************** */
+
+bool LogStorage::ReadBlock(std::size_t block_idx, char *dest)
+{
+    auto found = m_index.find(block_idx);
+    if (found == m_index.end())
+    {
+        std::memset(dest, 0, BLOCK_SIZE);
+        return (true);
+    }
+
+    const Location &location = found->second;
+    if (!PreadAll(m_segments[location.m_segment_id].m_fd, dest, BLOCK_SIZE,
+                  location.m_record_offset + sizeof(RecordHeader)))
+    {
+        m_logger->Error(std::string("[MINION] LogStorage, pread(), ") + std::strerror(errno));
+        return (false);
+    }
+
+    return (true);
+}
+
+bool LogStorage::StageBlock(std::size_t block_idx, const char *data)
+{
+    const Segment &active = m_segments[m_active_segment_id];
+    std::size_t staged_records = m_staging.size() / RECORD_SIZE;
+
+    if (m_segment_capacity <= active.m_tail / RECORD_SIZE + staged_records && !FlushStaging())
+    {
+        return (false);
+    }
+
+    RecordHeader header = {RECORD_MAGIC, 0, block_idx, m_seq_counter++};
+    header.m_checksum = Checksum(header, data);
+    const char *header_runner = reinterpret_cast<const char *>(&header);
+
+    m_staging.insert(m_staging.end(), header_runner, header_runner + sizeof(RecordHeader));
+    m_staging.insert(m_staging.end(), data, data + BLOCK_SIZE);
+
+    return (true);
+}
+
+bool LogStorage::FlushStaging()
+{
+    if (m_staging.empty())
+    {
+        return (true);
+    }
+
+    Segment &active = m_segments[m_active_segment_id];
+
+    if (!PwriteAll(active.m_fd, m_staging.data(), m_staging.size(), active.m_tail))
+    {
+        m_logger->Error(std::string("[MINION] LogStorage, pwrite(), ") + std::strerror(errno));
+        m_staging.clear();
+        return (false);
+    }
+
+    for (std::size_t runner = 0; runner < m_staging.size(); runner += RECORD_SIZE)
+    {
+        const RecordHeader *header = reinterpret_cast<const RecordHeader *>(&m_staging[runner]);
+        UpdateIndex(header->m_block_idx, Location{m_active_segment_id, active.m_tail + runner, header->m_seq});
+    }
+
+    active.m_tail += m_staging.size();
+    active.m_dirty = true;
+    m_staging.clear();
+
+    if (m_segment_capacity * RECORD_SIZE <= active.m_tail)
+    {
+        RollSegment();
+    }
+
+    return (true);
+}
+
+void LogStorage::UpdateIndex(std::size_t block_idx, const Location &location)
+{
+    auto found = m_index.find(block_idx);
+    if (found != m_index.end())
+    {
+        --m_segments[found->second.m_segment_id].m_live_records;
+        found->second = location;
+    }
+    else
+    {
+        m_index.insert({block_idx, location});
+    }
+
+    ++m_segments[location.m_segment_id].m_live_records;
+}
+
+unsigned LogStorage::Checksum(const RecordHeader &header, const char *data)
+{
+    RecordHeader unsummed = header;
+    unsummed.m_checksum = 0;
+
+    unsigned crc = Crc32(0, reinterpret_cast<const char *>(&unsummed), sizeof(RecordHeader));
+
+    return (Crc32(crc, data, BLOCK_SIZE));
+}
+
+/* Compaction */
+/* ************************************************************************** */
+
+void LogStorage::Compactor()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_run)
+    {
+        std::size_t victim_id = 0;
+
+        if (PickVictim(victim_id))
+        {
+            if (!Compact(lock, victim_id) && m_run)
+            {
+                m_compact_cond.wait(lock);
+            }
+            continue;
+        }
+
+        m_compact_cond.wait(lock);
+    }
+}
+
+bool LogStorage::PickVictim(std::size_t &victim_id)
+{
+    bool found = false;
+    double min_ratio = COMPACT_LIVE_RATIO;
+
+    for (const auto &segment : m_segments)
+    {
+        double ratio = static_cast<double>(segment.second.m_live_records) / m_segment_capacity;
+
+        if (segment.first != m_active_segment_id && ratio < min_ratio)
+        {
+            min_ratio = ratio;
+            victim_id = segment.first;
+            found = true;
+        }
+    }
+
+    return (found);
+}
+
+bool LogStorage::Compact(std::unique_lock<std::mutex> &lock, std::size_t victim_id)
+{
+    int victim_fd = m_segments[victim_id].m_fd;
+    std::size_t victim_tail = m_segments[victim_id].m_tail;
+    std::vector<char> chunk(COMPACT_CHUNK_RECORDS * RECORD_SIZE);
+
+    for (std::size_t offset = 0; offset < victim_tail && m_run; offset += chunk.size())
+    {
+        std::size_t chunk_len = std::min(chunk.size(), victim_tail - offset);
+
+        lock.unlock();
+        bool status = PreadAll(victim_fd, chunk.data(), chunk_len, offset);
+        lock.lock();
+
+        if (!status)
+        {
+            m_logger->Error(std::string("[MINION] LogStorage compaction, pread(), ") + std::strerror(errno));
+            return (false);
+        }
+
+        for (std::size_t runner = 0; runner < chunk_len; runner += RECORD_SIZE)
+        {
+            const RecordHeader *header = reinterpret_cast<const RecordHeader *>(&chunk[runner]);
+            auto found = m_index.find(header->m_block_idx);
+
+            if (found != m_index.end()
+             && victim_id == found->second.m_segment_id
+             && offset + runner == found->second.m_record_offset
+             && !StageBlock(header->m_block_idx, &chunk[runner] + sizeof(RecordHeader)))
+            {
+                return (false);
+            }
+        }
+
+        if (!FlushStaging())
+        {
+            return (false);
+        }
+    }
+
+    // the copies must be durable before the victim disappears
+    lock.unlock();
+    bool status = Flush();
+    lock.lock();
+
+    if (!status || !m_run || 0 != m_segments[victim_id].m_live_records)
+    {
+        return (false);
+    }
+
+    close(victim_fd);
+    unlink(SegmentName(victim_id).c_str());
+    m_segments.erase(victim_id);
+
+    return (true);
+}
+
+namespace
+{
+unsigned Crc32(unsigned crc, const char *data, std::size_t len)
+{
+    static const std::vector<unsigned> table = MakeCrc32Table();
+
+    crc = ~crc;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+
+    return (~crc);
+}
+
+std::vector<unsigned> MakeCrc32Table()
+{
+    std::vector<unsigned> table(256);
+
+    for (unsigned i = 0; i < table.size(); ++i)
+    {
+        unsigned crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+        }
+        table[i] = crc;
+    }
+
+    return (table);
+}
+
+bool PreadAll(int fd, char *buf, std::size_t len, std::size_t offset)
+{
+    ssize_t bytes_read = 0;
+
+    while (0 < len)
+    {
+        if (0 > (bytes_read = pread(fd, buf, len, offset)))
+        {
+            if (errno == EINTR){ continue; }
+            return (false);
+        }
+
+        if (0 == bytes_read)
+        {
+            return (false);
+        }
+
+        buf += bytes_read;
+        offset += bytes_read;
+        len -= bytes_read;
+    }
+
+    return (true);
+}
+
+bool PwriteAll(int fd, const char *buf, std::size_t len, std::size_t offset)
+{
+    ssize_t bytes_written = 0;
+
+    while (0 < len)
+    {
+        if (0 > (bytes_written = pwrite(fd, buf, len, offset)))
+        {
+            if (errno == EINTR){ continue; }
+            return (false);
+        }
+
+        buf += bytes_written;
+        offset += bytes_written;
+        len -= bytes_written;
+    }
+
+    return (true);
+}
+
+std::string DirName(const std::string &path_prefix)
+{
+    std::size_t delim_pos = path_prefix.find_last_of('/');
+    return (std::string::npos == delim_pos ? "." : path_prefix.substr(0, delim_pos + 1));
+}
+
+std::vector<std::size_t> ListSegments(const std::string &path_prefix)
+{
+    std::size_t delim_pos = path_prefix.find_last_of('/');
+    std::string dir_path = DirName(path_prefix);
+    std::string name_prefix = path_prefix.substr(std::string::npos == delim_pos ? 0 : delim_pos + 1) + SEGMENT_SUFFIX;
+
+    std::vector<std::size_t> segment_ids;
+
+    DIR *dir = opendir(dir_path.c_str());
+    if (nullptr == dir)
+    {
+        return (segment_ids);
+    }
+
+    for (dirent *entry = readdir(dir); nullptr != entry; entry = readdir(dir))
+    {
+        std::string name(entry->d_name);
+
+        if (name.size() > name_prefix.size() && 0 == name.compare(0, name_prefix.size(), name_prefix)
+         && std::string::npos == name.find_first_not_of("0123456789", name_prefix.size()))
+        {
+            segment_ids.push_back(std::strtoul(name.c_str() + name_prefix.size(), nullptr, 10));
+        }
+    }
+
+    closedir(dir);
+
+    std::sort(segment_ids.begin(), segment_ids.end());
+
+    return (segment_ids);
+}
+} // namespace
\ No newline at end of file
@@ -10,9 +10,13 @@
 
 #include <algorithm> // std::min
 #include <string> // std::string
+#include <iterator> // std::next
 
 #include <ifaddrs.h> // getifaddrs
+#include <sys/uio.h> // iovec
 
+#include "log_storage.hpp" // nsrd::LogStorage
+#include "cached_storage.hpp" // nsrd::CachedStorage
 #include "minion.hpp"
 
 using namespace nsrd;
@@ -21,42 +25,76 @@ namespace
 {
 std::string STORAGE_FILE_NAME("minion_storage_");
 std::string LOG_FILE_NAME("minion_log_");
+const std::size_t DATAGRAM_SIZE = 1024;
+const std::size_t WORKERS_NUM = 4;
+const std::chrono::minutes SESSIONS_SWEEP_INTERVAL(1);
 void InitSockaddr(struct sockaddr *sa, const char *addr, unsigned short port);
-void InitEvent(MinionEvent *event, std::size_t cmd_id, nsrd::MinionEventType type, std::size_t offset, std::size_t length);
+void InitEvent(MinionEvent *event, const MinionEvent &request, nsrd::MinionEventType type);
+bool IsHeader(const char *buf, std::size_t length);
 void CleanUpSocket(int socket);
 std::string FindLocalIp();
 }
 
-Minion::Minion(unsigned short port, std::size_t storage_size)
+class Minion::ServeTask : public Task
+{
+public:
+    ServeTask(Minion *minion, const std::shared_ptr<Session> &session)
+        : m_minion(minion), m_session(session)
+    {}
+
+    void operator()()
+    {
+        m_minion->Serve(m_session);
+    }
+
+private:
+    Minion *m_minion;
+    std::shared_ptr<Session> m_session;
+};
+
+const std::size_t Minion::DEFAULT_CACHE_SIZE;
+const std::chrono::minutes Minion::SESSION_IDLE_TIMEOUT(10);
+
+Minion::Minion(unsigned short port, std::size_t storage_size, StorageType storage_type,
+               std::size_t cache_size)
     : m_minion_port(port),
       m_minion_socket(0),
-      m_proxy_sa(),
-      m_proxy_sa_len(sizeof(struct sockaddr_in)),
-      m_storage_file(0),
+      m_storage(),
+      m_group_commit(),
+      m_sessions(),
+      m_incoming(),
       m_run(false),
-      m_stop_reactor_pipe(),
       m_logger(Handleton<Logger>::GetInstance()),
-      m_reactor()
+      m_workers(),
+      m_reactor(Listener::EPOLL)
 {
     OpenSocket();
 
     std::string str_port = std::to_string(port);
 
-    std::string file_name(STORAGE_FILE_NAME + str_port);
-    m_storage_file = open(file_name.c_str(), O_CREAT | O_RDWR, 0666);
-
     nsrd::Logger::SetPath(LOG_FILE_NAME + str_port);
 
-    if (-1 == pipe(m_stop_reactor_pipe))
+    std::string file_name(STORAGE_FILE_NAME + str_port);
+    if (LOG_STORAGE == storage_type)
     {
-        m_logger->Error("[MINION] COULDN'T OPEN CLOSING PIPE");
-        throw::std::runtime_error("[MINION] COULDN'T OPEN CLOSING PIPE");
+        m_storage.reset(new LogStorage(file_name));
+    }
+    else
+    {
+        m_storage.reset(new FileStorage(file_name));
     }
 
-    m_reactor.Add(m_stop_reactor_pipe[READ_END], std::bind(&Minion::StopReactorHandler, this),
-                                                                        SocketEventType::READ);
+    if (0 < cache_size)
+    {
+        m_storage.reset(new CachedStorage(std::move(m_storage), cache_size));
+    }
+
+    m_group_commit.reset(new GroupCommit(*m_storage));
+    m_workers.reset(new ThreadPool(WORKERS_NUM));
 
     m_reactor.Add(m_minion_socket, std::bind(&Minion::InputMediator, this), SocketEventType::READ);
+    m_reactor.AddTimer(SESSIONS_SWEEP_INTERVAL, std::bind(&Minion::ExpireSessions, this),
+                       SESSIONS_SWEEP_INTERVAL);
 
     int v = storage_size;
     (void) v;
@@ -65,9 +103,26 @@ Minion::Minion(unsigned short port, std::size_t storage_size)
 Minion::~Minion()
 {
     m_logger->Info("[MINION] DESTROYED");
+    // the running requests finish, and may still request flushes; the
+    // queued ones are dropped unanswered and their masters retransmit them
+    m_workers.reset();
+    m_group_commit.reset();
     close(m_minion_socket);
-    close(m_stop_reactor_pipe[READ_END]);
-    close(m_stop_reactor_pipe[WRITE_END]);
+}
+
+bool Minion::SessionKey::operator<(const SessionKey &other) const
+{
+    if (m_addr != other.m_addr)
+    {
+        return (m_addr < other.m_addr);
+    }
+
+    if (m_port != other.m_port)
+    {
+        return (m_port < other.m_port);
+    }
+
+    return (m_session_id < other.m_session_id);
 }
 
 void Minion::OpenSocket()
@@ -90,95 +145,132 @@ void Minion::OpenSocket()
     }
 }
 
-void Minion::AcceptProxyConnection()
+void Minion::InputMediator()
 {
-    MinionEvent request;
-    ReadConnectionRequest(&request);
+    char buf[DATAGRAM_SIZE];
+    sockaddr from_sa = {0, {0}};
+    socklen_t from_sa_len = sizeof(sockaddr);
+    ssize_t bytes_read = 0;
 
-    if (nsrd::MinionEventType::START_COMMUNICATE != request.m_type)
+    do
     {
-        m_logger->Error("[MINION] EXPECTED START_COMMUNICATE EVENT TYPE");
-        throw std::runtime_error("[MINION] EXPECTED START_COMMUNICATE EVENT TYPE");
+        bytes_read = recvfrom(m_minion_socket, buf, DATAGRAM_SIZE, 0, &from_sa, &from_sa_len);
     }
+    while (0 > bytes_read && errno == EINTR);
 
-    MinionEvent response;
-    InitEvent(&response, request.m_event_id, nsrd::MinionEventType::RESPONSE_SUCCESS, request.m_offset, request.m_length);
-
-    SendData(&response, sizeof(MinionEvent));
-
-    m_logger->Info("[MINION] PROXY HAS BEEN CONNECTED");
-}
+    if (0 > bytes_read)
+    {
+        m_logger->Error(std::string("[MINION] READDATA HAS FAILED ") + std::strerror(errno));
+        return;
+    }
 
-void Minion::Write(const MinionEvent &request)
-{
-    void *buf = operator new(request.m_length);
-    std::memset(buf, 0, request.m_length);
+    const sockaddr_in *from_sai = reinterpret_cast<const sockaddr_in *>(&from_sa);
+    SessionKey peer = {from_sai->sin_addr.s_addr, from_sai->sin_port, 0};
 
-    ReadData(buf, request.m_length);
-    StorageWrite(buf, request.m_length, request.m_offset);
+    if (ReceivePayload(peer, buf, bytes_read))
+    {
+        return;
+    }
 
-    operator delete (buf);
+    if (!IsHeader(buf, bytes_read))
+    {
+        m_logger->Error("[MINION] RECEIVED DATAGRAM IS NOT A REQUEST");
+        return;
+    }
 
-    MinionEvent response;
-    InitEvent(&response, request.m_event_id, nsrd::MinionEventType::RESPONSE_SUCCESS, request.m_offset, request.m_length);
+    MinionEvent request;
+    std::memcpy(&request, buf, sizeof(MinionEvent));
 
-    SendData(&response, sizeof(MinionEvent));
+    HandleRequest(from_sa, request);
 }
 
-void Minion::Read(const MinionEvent &request)
+bool Minion::ReceivePayload(const SessionKey &peer, const char *buf, std::size_t length)
 {
-    void *buf = operator new(request.m_length);
-    std::memset(buf, 0, request.m_length);
+    std::map<SessionKey, IncomingWrite>::iterator incoming = m_incoming.find(peer);
+    if (m_incoming.end() == incoming)
+    {
+        return (false);
+    }
 
-    StorageRead(buf, request.m_length, request.m_offset);
+    IncomingWrite &write = incoming->second;
+    std::size_t left = write.m_request.m_data.size() - write.m_received;
 
-    MinionEvent response;
-    InitEvent(&response, request.m_event_id, nsrd::MinionEventType::RESPONSE_SUCCESS, request.m_offset, request.m_length);
+    // a header instead of the payload means the proxy gave up on this write
+    if (left != length && IsHeader(buf, length))
+    {
+        m_logger->Error("[MINION] WRITE PAYLOAD IS INCOMPLETE, DROPPING IT");
+        m_incoming.erase(incoming);
+        return (false);
+    }
 
-    SendData(&response, sizeof(MinionEvent));
-    SendData(buf, request.m_length);
-    SendData(&response, sizeof(MinionEvent));
+    length = std::min(length, left);
+    std::memcpy(&write.m_request.m_data[write.m_received], buf, length);
+    write.m_received += length;
+    write.m_last_datagram = std::chrono::steady_clock::now();
+    write.m_session->m_last_request = write.m_last_datagram;
 
-    operator delete (buf);
-}
-
-void Minion::StopReactorHandler()
-{
-    char buf[1];
-    if (-1 == read(m_stop_reactor_pipe[READ_END], buf, 1))
+    if (write.m_received == write.m_request.m_data.size())
     {
-        m_logger->Error("[MINION] CLOSING PIPE");
+        Enqueue(write.m_session, write.m_request);
+        m_incoming.erase(incoming);
     }
 
-    m_reactor.Stop();
+    return (true);
 }
 
-void Minion::InputMediator()
+void Minion::HandleRequest(const sockaddr &from_sa, const MinionEvent &request)
 {
-    MinionEvent request;
-    ReadData(&request, sizeof(MinionEvent));
+    const sockaddr_in *from_sai = reinterpret_cast<const sockaddr_in *>(&from_sa);
+    SessionKey key = {from_sai->sin_addr.s_addr, from_sai->sin_port, request.m_session_id};
 
-    if (request.m_event_id == 0 || request.m_magic != MINION_EVENT_MAGIC)
+    if (nsrd::MinionEventType::STOP_COMMUNICATE == request.m_type)
     {
-        CleanUpSocket(m_minion_socket);
+        m_sessions.erase(key);
+        m_logger->Info("[MINION] PROXY HAS BEEN DISCONNECTED");
         return;
     }
-    
+
+    std::shared_ptr<Session> &session = m_sessions[key];
+    if (!session)
+    {
+        session.reset(new Session());
+        session->m_peer_sa = from_sa;
+        session->m_is_served = false;
+        m_logger->Info("[MINION] PROXY HAS BEEN CONNECTED");
+
+        DropOtherSessions(key);
+    }
+    session->m_last_request = std::chrono::steady_clock::now();
+
+    Request incoming = {request, std::vector<char>()};
+
     switch (request.m_type)
     {
-        case (nsrd::MinionEventType::WRITE):
+        case (nsrd::MinionEventType::START_COMMUNICATE):
         {
-            Write(request);
+            MinionEvent response;
+            InitEvent(&response, request, nsrd::MinionEventType::RESPONSE_SUCCESS);
+            SendResponse(*session, response);
             break;
         }
-        case (nsrd::MinionEventType::READ):
+        case (nsrd::MinionEventType::WRITE):
         {
-            Read(request);
+            if (0 == request.m_length)
+            {
+                Enqueue(session, incoming);
+                break;
+            }
+
+            SessionKey peer = {key.m_addr, key.m_port, 0};
+            IncomingWrite write = {session, incoming, 0, session->m_last_request};
+            write.m_request.m_data.resize(request.m_length);
+            m_incoming[peer] = write;
             break;
         }
-        case (nsrd::MinionEventType::STOP_COMMUNICATE):
+        case (nsrd::MinionEventType::READ):
+        case (nsrd::MinionEventType::FLUSH):
         {
-            Stop();
+            Enqueue(session, incoming);
             break;
         }
         default:
@@ -189,130 +281,244 @@ void Minion::InputMediator()
     }
 }
 
-void Minion::Run()
+void Minion::DropOtherSessions(const SessionKey &key)
 {
-    CleanUpSocket(m_minion_socket);
-    
-    AcceptProxyConnection();
+    // a proxy socket keeps its session id, a new one from its address means
+    // the socket was opened anew, e.g. by a restarted master
+    SessionKey first = {key.m_addr, key.m_port, 0};
+    std::map<SessionKey, std::shared_ptr<Session> >::iterator session = m_sessions.lower_bound(first);
 
-    if (!m_run)
+    while (m_sessions.end() != session &&
+           key.m_addr == session->first.m_addr && key.m_port == session->first.m_port)
     {
-        m_run = true;
-        m_logger->Info("[MINION] STARTS");
-        m_reactor.Run();
+        if (key.m_session_id == session->first.m_session_id)
+        {
+            ++session;
+            continue;
+        }
+
+        m_logger->Info("[MINION] PROXY HAS BEEN REPLACED, DROPPING ITS OLD SESSION");
+        session = m_sessions.erase(session);
     }
 }
 
-void Minion::Stop()
+void Minion::ExpireSessions()
 {
-    m_logger->Info("[MINION] RECEIVED STOP_COMMUNICATE REQUEST"); 
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::size_t expired = 0;
 
-    if (m_run)
+    for (auto session = m_sessions.begin(); m_sessions.end() != session;)
     {
-        m_run = false;
-        if (-1 == write(m_stop_reactor_pipe[WRITE_END], "", 1))
+        bool is_idle = false;
         {
-            m_logger->Error("[MINION] GOT ERROR STOPPING MONITOR");
+            std::unique_lock<std::mutex> lock(session->second->m_requests_mutex);
+            is_idle = !session->second->m_is_served &&
+                      SESSION_IDLE_TIMEOUT <= now - session->second->m_last_request;
         }
+
+        if (is_idle)
+        {
+            ++expired;
+            session = m_sessions.erase(session);
+        }
+        else
+        {
+            ++session;
+        }
+    }
+
+    // payloads a crashed master never finished
+    for (auto write = m_incoming.begin(); m_incoming.end() != write;)
+    {
+        write = SESSION_IDLE_TIMEOUT <= now - write->second.m_last_datagram ?
+                m_incoming.erase(write) : std::next(write);
+    }
+
+    if (0 < expired)
+    {
+        m_logger->Info("[MINION] " + std::to_string(expired) + " IDLE SESSIONS EXPIRED");
     }
 }
 
-bool Minion::SendData(void *buf, std::size_t length)
+void Minion::Enqueue(const std::shared_ptr<Session> &session, const Request &request)
 {
-    const char *buffer = static_cast<const char *>(buf);
-    std::size_t sendlen = std::min(length, 1024UL);
-    int bytes_written = 0;
+    bool should_serve = false;
 
-    while (0 < length)
     {
-        if (0 > (bytes_written = sendto(m_minion_socket, buffer, sendlen,
-                                            0, &m_proxy_sa, INET_ADDRSTRLEN)))
-        {
-            if (errno == EINTR){ continue; }
-            m_logger->Error(std::string("[MINION] SENDDATA HAS FAILED ") + std::strerror(errno));
-            return (false);
-        }
-
-        buffer += bytes_written;
-        length -= bytes_written;
-        sendlen = std::min(length, 1024UL);
+        std::unique_lock<std::mutex> lock(session->m_requests_mutex);
+        session->m_requests.push_back(request);
+        should_serve = !session->m_is_served;
+        session->m_is_served = true;
     }
 
-    return (true);
+    if (should_serve)
+    {
+        m_workers->Add(std::shared_ptr<Task>(new ServeTask(this, session)), ThreadPool::MEDIUM);
+    }
 }
 
-bool Minion::ReadData(void *buf, std::size_t length)
+void Minion::Serve(const std::shared_ptr<Session> &session)
 {
-    sockaddr from_sa = {0, {0}};
-    socklen_t from_sa_len = sizeof(sockaddr);
-    char *buffer = static_cast<char *>(buf);
-    int bytes_read = 0;
-
-    while (0 < length)
+    while (true)
     {
-        if (0 > (bytes_read = recvfrom(m_minion_socket, buffer, length, 0, &from_sa, &from_sa_len)))
+        Request request;
+
         {
-            if (errno == EINTR){ continue; }
-            m_logger->Error(std::string("[MINION] READDATA HAS FAILED ") + std::strerror(errno));
-            return (false);
+            std::unique_lock<std::mutex> lock(session->m_requests_mutex);
+            if (session->m_requests.empty())
+            {
+                session->m_is_served = false;
+                return;
+            }
+
+            request = session->m_requests.front();
+            session->m_requests.pop_front();
         }
 
-        if (0 != std::memcmp(from_sa.sa_data, m_proxy_sa.sa_data, 14))
+        switch (request.m_event.m_type)
         {
-            m_logger->Error("[MINION] RECEIVED DATA IS NOT FROM THE CURRENT PROXY");
-            return (false);
+            case (nsrd::MinionEventType::WRITE):
+            {
+                Write(session, request);
+                break;
+            }
+            case (nsrd::MinionEventType::READ):
+            {
+                Read(session, request);
+                break;
+            }
+            case (nsrd::MinionEventType::FLUSH):
+            {
+                Flush(session, request);
+                break;
+            }
+            default:
+            {
+                break;
+            }
         }
-        
-        buffer += bytes_read;
-        length -= bytes_read;
     }
+}
 
-    return (true);
+void Minion::Write(const std::shared_ptr<Session> &session, const Request &request)
+{
+    const MinionEvent &event = request.m_event;
+    bool status = m_storage->Write(request.m_data.data(), event.m_length, event.m_offset);
+
+    Respond(session, event, status);
 }
 
-void Minion::ReadConnectionRequest(MinionEvent *event)
+void Minion::Read(const std::shared_ptr<Session> &session, const Request &request)
 {
-    std::size_t length = sizeof(MinionEvent);
-    int bytes_read = 0;
+    const MinionEvent &event = request.m_event;
+
+    void *buf = operator new(event.m_length);
+    std::memset(buf, 0, event.m_length);
 
-    while (0 < length)
+    if (!m_storage->Read(buf, event.m_length, event.m_offset))
     {
-        if (0 > (bytes_read = recvfrom(m_minion_socket, event, length, 0, &m_proxy_sa, &m_proxy_sa_len)))
-        {
-            if (errno == EINTR){ continue; }
-            m_logger->Error("[MINION] READING CONNECTION REQUEST HAS FAILED");
-            throw std::runtime_error("[MINION] READING CONNECTION REQUEST HAS FAILED");
-        }
-        
-        event += bytes_read;
-        length -= bytes_read;
+        Respond(session, event, false);
+        operator delete (buf);
+        return;
     }
+
+    MinionEvent response;
+    InitEvent(&response, event, nsrd::MinionEventType::RESPONSE_SUCCESS);
+
+    SendResponse(*session, response, buf);
+
+    operator delete (buf);
+}
+
+void Minion::Flush(const std::shared_ptr<Session> &session, const Request &request)
+{
+    m_group_commit->RequestFlush(std::bind(&Minion::FlushDone, this, session, request.m_event, std::placeholders::_1));
+}
+
+void Minion::FlushDone(const std::shared_ptr<Session> &session, const MinionEvent &request, bool status)
+{
+    Respond(session, request, status);
 }
 
-void Minion::StorageRead(void *buf, unsigned len, std::size_t offset)
+void Minion::Respond(const std::shared_ptr<Session> &session, const MinionEvent &request, bool status)
 {
-    if (-1 == lseek(m_storage_file, offset, SEEK_SET))
+    MinionEvent response;
+    InitEvent(&response, request,
+              status ? nsrd::MinionEventType::RESPONSE_SUCCESS : nsrd::MinionEventType::RESPONSE_FAIL);
+
+    SendResponse(*session, response);
+}
+
+void Minion::Run()
+{
+    CleanUpSocket(m_minion_socket);
+
+    if (!m_run)
     {
-        m_logger->Error(std::string("[MINION] StorageRead, lseek(), ") + std::strerror(errno));
+        m_run = true;
+        m_logger->Info("[MINION] STARTS");
+        m_reactor.Run();
     }
+}
+
+void Minion::Stop()
+{
+    m_logger->Info("[MINION] STOPS");
 
-    if (-1 == read(m_storage_file, buf, len))
+    if (m_run)
     {
-        m_logger->Error(std::string("[MINION] StorageRead, read(), ") + std::strerror(errno));
-    }    
+        m_run = false;
+        m_reactor.Post(std::bind(&Reactor::Stop, &m_reactor));
+    }
 }
 
-void Minion::StorageWrite(void *buf, unsigned len, std::size_t offset)
+bool Minion::SendResponse(Session &session, const MinionEvent &response, const void *buf)
 {
-    if (-1 == lseek(m_storage_file, offset, SEEK_SET))
+    std::unique_lock<std::mutex> lock(session.m_send_mutex);
+
+    if (!buf)
     {
-        m_logger->Error(std::string("[MINION] StorageWrite, lseek(), ") + std::strerror(errno));
+        return (SendReply(session.m_peer_sa, response, nullptr, 0));
     }
 
-    if (-1 == write(m_storage_file, buf, len))
+    const char *data = static_cast<const char *>(buf);
+    MinionEvent piece = response;
+    std::size_t piece_pos = 0;
+    bool status = true;
+
+    do
+    {
+        std::size_t piece_length = std::min(response.m_length - piece_pos, MINION_MAX_REPLY_DATA);
+        piece.m_offset = response.m_offset + piece_pos;
+        status = SendReply(session.m_peer_sa, piece, data + piece_pos, piece_length);
+
+        piece_pos += piece_length;
+    }
+    while (status && piece_pos < response.m_length);
+
+    return (status);
+}
+
+bool Minion::SendReply(const sockaddr &to_sa, const MinionEvent &response, const char *data, std::size_t length)
+{
+    iovec iov[2] = {{const_cast<MinionEvent *>(&response), sizeof(MinionEvent)},
+                    {const_cast<char *>(data), length}};
+
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msghdr));
+    msg.msg_name = const_cast<sockaddr *>(&to_sa);
+    msg.msg_namelen = INET_ADDRSTRLEN;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (0 == length) ? 1 : 2;
+
+    while (0 > sendmsg(m_minion_socket, &msg, 0))
     {
-        m_logger->Error(std::string("[MINION] StorageWrite, write(), ") + std::strerror(errno));
+        if (errno == EINTR){ continue; }
+        m_logger->Error(std::string("[MINION] SENDREPLY HAS FAILED ") + std::strerror(errno));
+        return (false);
     }
+
+    return (true);
 }
 
 namespace
@@ -330,14 +536,28 @@ void InitSockaddr(sockaddr *sa, const char *addr, unsigned short port)
     }
 }
 
-void InitEvent(MinionEvent *event, std::size_t cmd_id, nsrd::MinionEventType type, std::size_t offset, std::size_t length)
+void InitEvent(MinionEvent *event, const MinionEvent &request, nsrd::MinionEventType type)
 {
     std::memset(event, 0, sizeof(MinionEvent));
     event->m_type = type;
     event->m_magic = MINION_EVENT_MAGIC;
-    event->m_event_id = cmd_id;
-    event->m_offset = offset;
-    event->m_length = length;   
+    event->m_event_id = request.m_event_id;
+    event->m_offset = request.m_offset;
+    event->m_length = request.m_length;
+    event->m_session_id = request.m_session_id;
+}
+
+bool IsHeader(const char *buf, std::size_t length)
+{
+    if (sizeof(MinionEvent) != length)
+    {
+        return (false);
+    }
+
+    MinionEvent event;
+    std::memcpy(&event, buf, sizeof(MinionEvent));
+
+    return (MINION_EVENT_MAGIC == event.m_magic && 0 != event.m_event_id);
 }
 
 void CleanUpSocket(int socket)
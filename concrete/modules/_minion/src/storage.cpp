@@ -0,0 +1,102 @@
+/*******************************************************************************
+*
+* FILENAME : storage.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 02.12.2023
+*
+*******************************************************************************/
+
+#include <fcntl.h> // open
+#include <unistd.h> // pread, pwrite, fdatasync, close
+#include <cerrno> // errno
+#include <cstring> // std::strerror, std::memset
+#include <stdexcept> // std::runtime_error
+
+#include "storage.hpp" // nsrd::IStorage, nsrd::FileStorage
+
+using namespace nsrd;
+
+IStorage::~IStorage()
+{}
+
+/* FileStorage */
+/* ************************************************************************** */
+
+FileStorage::FileStorage(const std::string &file_name)
+    : m_storage_file(open(file_name.c_str(), O_CREAT | O_RDWR, 0666)),
+      m_logger(Handleton<Logger>::GetInstance())
+{
+    if (-1 == m_storage_file)
+    {
+        m_logger->Error(std::string("[MINION] FileStorage, open(), ") + std::strerror(errno));
+        throw std::runtime_error("[MINION] COULDN'T OPEN STORAGE FILE");
+    }
+}
+
+FileStorage::~FileStorage() noexcept
+{
+    close(m_storage_file);
+}
+
+bool FileStorage::Read(void *buf, std::size_t len, std::size_t offset)
+{
+    char *buffer = static_cast<char *>(buf);
+    ssize_t bytes_read = 0;
+
+    while (0 < len)
+    {
+        if (0 > (bytes_read = pread(m_storage_file, buffer, len, offset)))
+        {
+            if (errno == EINTR){ continue; }
+            m_logger->Error(std::string("[MINION] StorageRead, pread(), ") + std::strerror(errno));
+            return (false);
+        }
+
+        if (0 == bytes_read)
+        {
+            std::memset(buffer, 0, len);
+            break;
+        }
+
+        buffer += bytes_read;
+        offset += bytes_read;
+        len -= bytes_read;
+    }
+
+    return (true);
+}
+
+bool FileStorage::Write(const void *buf, std::size_t len, std::size_t offset)
+{
+    const char *buffer = static_cast<const char *>(buf);
+    ssize_t bytes_written = 0;
+
+    while (0 < len)
+    {
+        if (0 > (bytes_written = pwrite(m_storage_file, buffer, len, offset)))
+        {
+            if (errno == EINTR){ continue; }
+            m_logger->Error(std::string("[MINION] StorageWrite, pwrite(), ") + std::strerror(errno));
+            return (false);
+        }
+
+        buffer += bytes_written;
+        offset += bytes_written;
+        len -= bytes_written;
+    }
+
+    return (true);
+}
+
+bool FileStorage::Flush()
+{
+    if (-1 == fdatasync(m_storage_file))
+    {
+        m_logger->Error(std::string("[MINION] StorageFlush, fdatasync(), ") + std::strerror(errno));
+        return (false);
+    }
+
+    return (true);
+}
\ No newline at end of file
@@ -0,0 +1,400 @@
+/*******************************************************************************
+*
+* FILENAME : minion_test.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 02.12.2023
+*
+*******************************************************************************/
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <memory> // std::unique_ptr
+#include <mutex> // std::mutex
+#include <atomic> // std::atomic
+#include <algorithm> // std::copy
+#include <utility> // std::move
+#include <cstring> // std::memcpy, std::memcmp
+#include <fcntl.h> // open
+#include <unistd.h> // pwrite, close, unlink, sleep
+#include <dirent.h> // opendir, readdir, closedir
+#include <sys/stat.h> // stat
+
+#include "testing.hpp" // testing::Testscmp, testing::UnitTest
+
+#include "log_storage.hpp" // nsrd::LogStorage
+#include "cached_storage.hpp" // nsrd::CachedStorage
+
+using namespace nsrd;
+using namespace nsrd::testing;
+
+namespace
+{
+const std::string LOG_PREFIX("./minion_test_log");
+const std::size_t BLOCK = LogStorage::BLOCK_SIZE;
+
+void TestLogReadWrite();
+void TestLogReopen();
+void TestLogTornRecord();
+void TestLogCompaction();
+void TestCacheReadWrite();
+void TestCacheEviction();
+void TestCacheReadahead();
+} // namespace
+
+int main()
+{
+    Testscmp cmp;
+    cmp.AddTest(UnitTest("Log storage read/write", TestLogReadWrite));
+    cmp.AddTest(UnitTest("Log storage reopen", TestLogReopen));
+    cmp.AddTest(UnitTest("Log storage torn record", TestLogTornRecord));
+    cmp.AddTest(UnitTest("Log storage compaction", TestLogCompaction));
+    cmp.AddTest(UnitTest("Cached storage read/write", TestCacheReadWrite));
+    cmp.AddTest(UnitTest("Cached storage eviction", TestCacheEviction));
+    cmp.AddTest(UnitTest("Cached storage readahead", TestCacheReadahead));
+    cmp.Run();
+
+    return (0);
+}
+
+namespace
+{
+// in memory, counting the reads that reach it
+class MemoryStorage : public IStorage
+{
+public:
+    explicit MemoryStorage(std::size_t size, std::atomic<std::size_t> *reads);
+
+    bool Read(void *buf, std::size_t len, std::size_t offset);
+    bool Write(const void *buf, std::size_t len, std::size_t offset);
+    bool Flush();
+
+private:
+    std::vector<char> m_data;
+    std::atomic<std::size_t> *m_reads;
+    std::mutex m_mutex; // the prefetcher reads alongside the test
+};
+
+MemoryStorage::MemoryStorage(std::size_t size, std::atomic<std::size_t> *reads)
+    : m_data(size, 0), m_reads(reads), m_mutex()
+{}
+
+bool MemoryStorage::Read(void *buf, std::size_t len, std::size_t offset)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ++*m_reads;
+
+    if (m_data.size() < offset + len)
+    {
+        return (false);
+    }
+    std::memcpy(buf, m_data.data() + offset, len);
+
+    return (true);
+}
+
+bool MemoryStorage::Write(const void *buf, std::size_t len, std::size_t offset)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (m_data.size() < offset + len)
+    {
+        return (false);
+    }
+    std::memcpy(m_data.data() + offset, buf, len);
+
+    return (true);
+}
+
+bool MemoryStorage::Flush()
+{
+    return (true);
+}
+
+std::vector<std::string> LogSegments()
+{
+    std::vector<std::string> names;
+
+    DIR *dir = opendir(".");
+    for (dirent *entry = readdir(dir); nullptr != entry; entry = readdir(dir))
+    {
+        std::string name = std::string("./") + entry->d_name;
+        if (0 == name.compare(0, LOG_PREFIX.size(), LOG_PREFIX))
+        {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+
+    return (names);
+}
+
+void RemoveLog()
+{
+    for (const std::string &name : LogSegments())
+    {
+        unlink(name.c_str());
+    }
+}
+
+std::vector<char> Pattern(std::size_t len, char seed)
+{
+    std::vector<char> data(len);
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        data[i] = static_cast<char>(seed + i % 251);
+    }
+
+    return (data);
+}
+
+bool Holds(IStorage &storage, const std::vector<char> &data, std::size_t offset)
+{
+    std::vector<char> read(data.size());
+
+    return (storage.Read(read.data(), read.size(), offset) &&
+            0 == std::memcmp(read.data(), data.data(), data.size()));
+}
+
+void TestLogReadWrite()
+{
+    RemoveLog();
+    {
+        LogStorage storage(LOG_PREFIX);
+
+        // never written, zeroes
+        TH_ASSERT(Holds(storage, std::vector<char>(3 * BLOCK, 0), 0));
+
+        std::vector<char> aligned = Pattern(2 * BLOCK, 1);
+        TH_ASSERT(storage.Write(aligned.data(), aligned.size(), BLOCK));
+        TH_ASSERT(Holds(storage, aligned, BLOCK));
+
+        // across a block boundary, keeping the rest of both blocks
+        std::vector<char> unaligned = Pattern(BLOCK / 2, 7);
+        TH_ASSERT(storage.Write(unaligned.data(), unaligned.size(), BLOCK + BLOCK * 3 / 4));
+        TH_ASSERT(Holds(storage, unaligned, BLOCK + BLOCK * 3 / 4));
+        TH_ASSERT(Holds(storage, std::vector<char>(aligned.begin(), aligned.begin() + BLOCK * 3 / 4),
+                        BLOCK));
+        TH_ASSERT(Holds(storage, std::vector<char>(aligned.begin() + BLOCK * 5 / 4, aligned.end()),
+                        BLOCK + BLOCK * 5 / 4));
+        TH_ASSERT(Holds(storage, std::vector<char>(BLOCK, 0), 0));
+
+        TH_ASSERT(storage.Flush());
+        TH_ASSERT(storage.Flush()); // nothing left to sync
+    }
+    RemoveLog();
+}
+
+void TestLogReopen()
+{
+    RemoveLog();
+
+    std::vector<char> first = Pattern(4 * BLOCK, 3);
+    std::vector<char> second = Pattern(BLOCK, 9);
+    {
+        LogStorage storage(LOG_PREFIX);
+        TH_ASSERT(storage.Write(first.data(), first.size(), 0));
+        TH_ASSERT(storage.Write(second.data(), second.size(), 2 * BLOCK));
+        TH_ASSERT(storage.Flush());
+    }
+    {
+        // the latest version of each block
+        LogStorage storage(LOG_PREFIX);
+        TH_ASSERT(Holds(storage, std::vector<char>(first.begin(), first.begin() + 2 * BLOCK), 0));
+        TH_ASSERT(Holds(storage, second, 2 * BLOCK));
+        TH_ASSERT(Holds(storage, std::vector<char>(first.begin() + 3 * BLOCK, first.end()),
+                        3 * BLOCK));
+
+        // appended after the replayed records
+        TH_ASSERT(storage.Write(first.data(), BLOCK, 2 * BLOCK));
+        TH_ASSERT(storage.Flush());
+    }
+    {
+        LogStorage storage(LOG_PREFIX);
+        TH_ASSERT(Holds(storage, std::vector<char>(first.begin(), first.begin() + BLOCK), 2 * BLOCK));
+    }
+
+    RemoveLog();
+}
+
+void TestLogTornRecord()
+{
+    RemoveLog();
+
+    std::vector<char> older = Pattern(BLOCK, 5);
+    std::vector<char> newer = Pattern(BLOCK, 11);
+    {
+        LogStorage storage(LOG_PREFIX);
+        TH_ASSERT(storage.Write(older.data(), older.size(), 0));
+        TH_ASSERT(storage.Write(newer.data(), newer.size(), 0));
+        TH_ASSERT(storage.Flush());
+    }
+
+    // a crash left the header of the newer record but not its data
+    std::vector<std::string> segments = LogSegments();
+    TH_ASSERT(1 == segments.size());
+
+    struct stat st;
+    TH_ASSERT(0 == stat(segments[0].c_str(), &st));
+    std::size_t record_size = st.st_size / 2;
+
+    int fd = open(segments[0].c_str(), O_WRONLY);
+    std::vector<char> zeroes(BLOCK, 0);
+    TH_ASSERT(static_cast<ssize_t>(BLOCK) ==
+              pwrite(fd, zeroes.data(), zeroes.size(), 2 * record_size - BLOCK));
+    close(fd);
+
+    {
+        LogStorage storage(LOG_PREFIX);
+        TH_ASSERT(Holds(storage, older, 0));
+
+        // the torn record is overwritten by the next one
+        TH_ASSERT(storage.Write(newer.data(), newer.size(), BLOCK));
+        TH_ASSERT(storage.Flush());
+    }
+    {
+        LogStorage storage(LOG_PREFIX);
+        TH_ASSERT(Holds(storage, older, 0));
+        TH_ASSERT(Holds(storage, newer, BLOCK));
+    }
+
+    RemoveLog();
+}
+
+void TestLogCompaction()
+{
+    RemoveLog();
+
+    const std::size_t RECORDS_PER_SEGMENT = 4;
+    const std::size_t SEGMENTS = 10;
+
+    std::vector<char> live = Pattern(BLOCK, 13);
+    std::vector<char> latest;
+    {
+        // a little more than 4 records a segment
+        LogStorage storage(LOG_PREFIX, RECORDS_PER_SEGMENT * (BLOCK + 64));
+
+        TH_ASSERT(storage.Write(live.data(), live.size(), BLOCK));
+        for (std::size_t i = 0; i < RECORDS_PER_SEGMENT * SEGMENTS; ++i)
+        {
+            latest = Pattern(BLOCK, static_cast<char>(i));
+            TH_ASSERT(storage.Write(latest.data(), latest.size(), 0));
+        }
+        TH_ASSERT(storage.Flush());
+
+        sleep(1);
+
+        // the overwritten segments are gone, the live block moved on
+        TH_ASSERT(SEGMENTS / 2 > LogSegments().size());
+        TH_ASSERT(Holds(storage, live, BLOCK));
+        TH_ASSERT(Holds(storage, latest, 0));
+    }
+    {
+        LogStorage storage(LOG_PREFIX, RECORDS_PER_SEGMENT * (BLOCK + 64));
+        TH_ASSERT(Holds(storage, live, BLOCK));
+        TH_ASSERT(Holds(storage, latest, 0));
+    }
+
+    RemoveLog();
+}
+
+void TestCacheReadWrite()
+{
+    const std::size_t CBLOCK = CachedStorage::BLOCK_SIZE;
+
+    std::atomic<std::size_t> reads(0);
+    CachedStorage storage(std::unique_ptr<IStorage>(new MemoryStorage(16 * CBLOCK, &reads)),
+                          16 * CBLOCK, 0);
+
+    std::vector<char> data = Pattern(3 * CBLOCK, 2);
+    TH_ASSERT(storage.Write(data.data(), data.size(), CBLOCK));
+    TH_ASSERT(Holds(storage, data, CBLOCK));
+
+    // cached, within a block and across blocks
+    std::size_t loads = reads;
+    TH_ASSERT(Holds(storage, data, CBLOCK));
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + 100, data.begin() + 200),
+                    CBLOCK + 100));
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + CBLOCK / 2, data.end() - 1),
+                    CBLOCK + CBLOCK / 2));
+    TH_ASSERT(loads == reads);
+
+    // a write drops the blocks it touches, only those
+    std::vector<char> update = Pattern(CBLOCK / 2, 17);
+    TH_ASSERT(storage.Write(update.data(), update.size(), 2 * CBLOCK + CBLOCK / 4));
+    std::copy(update.begin(), update.end(), data.begin() + CBLOCK + CBLOCK / 4);
+    TH_ASSERT(Holds(storage, data, CBLOCK));
+    TH_ASSERT(loads + 1 == reads);
+
+    // out of the storage, the read fails and nothing is cached
+    std::vector<char> buf(CBLOCK);
+    TH_ASSERT(!storage.Read(buf.data(), buf.size(), 16 * CBLOCK));
+    TH_ASSERT(storage.Read(buf.data(), 0, 16 * CBLOCK));
+    TH_ASSERT(storage.Flush());
+}
+
+void TestCacheEviction()
+{
+    const std::size_t CBLOCK = CachedStorage::BLOCK_SIZE;
+    const std::size_t CAPACITY = 4;
+
+    std::atomic<std::size_t> reads(0);
+    std::vector<char> data = Pattern(16 * CBLOCK, 23);
+    std::unique_ptr<IStorage> memory(new MemoryStorage(data.size(), &reads));
+    TH_ASSERT(memory->Write(data.data(), data.size(), 0));
+
+    CachedStorage storage(std::move(memory), CAPACITY * CBLOCK, 0);
+
+    // every other block, not to look sequential
+    for (std::size_t i = 0; i <= CAPACITY; ++i)
+    {
+        std::size_t offset = 2 * i * CBLOCK;
+        TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + offset,
+                                                   data.begin() + offset + CBLOCK), offset));
+    }
+    TH_ASSERT(CAPACITY + 1 == reads);
+
+    // the least recently used went first
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + 2 * CAPACITY * CBLOCK,
+                                               data.begin() + (2 * CAPACITY + 1) * CBLOCK),
+                    2 * CAPACITY * CBLOCK));
+    TH_ASSERT(CAPACITY + 1 == reads);
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin(), data.begin() + CBLOCK), 0));
+    TH_ASSERT(CAPACITY + 2 == reads);
+}
+
+void TestCacheReadahead()
+{
+    const std::size_t CBLOCK = CachedStorage::BLOCK_SIZE;
+    const std::size_t BLOCKS = 64;
+
+    std::atomic<std::size_t> reads(0);
+    std::vector<char> data = Pattern(BLOCKS * CBLOCK, 29);
+    std::unique_ptr<IStorage> memory(new MemoryStorage(data.size(), &reads));
+    TH_ASSERT(memory->Write(data.data(), data.size(), 0));
+
+    CachedStorage storage(std::move(memory), BLOCKS * CBLOCK, 8 * CBLOCK);
+
+    // two reads make a stream, the next blocks are loaded ahead of it
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin(), data.begin() + CBLOCK), 0));
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + CBLOCK, data.begin() + 2 * CBLOCK),
+                    CBLOCK));
+    sleep(1);
+
+    // out of the stream's order, not to prefetch any further
+    std::size_t loads = reads;
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + 3 * CBLOCK,
+                                               data.begin() + 4 * CBLOCK), 3 * CBLOCK));
+    TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + 5 * CBLOCK,
+                                               data.begin() + 6 * CBLOCK), 5 * CBLOCK));
+    TH_ASSERT(loads == reads);
+
+    // on to the end, whether the prefetcher keeps up or not
+    for (std::size_t offset = 2 * CBLOCK; offset < data.size(); offset += 2 * CBLOCK)
+    {
+        TH_ASSERT(Holds(storage, std::vector<char>(data.begin() + offset,
+                                                   data.begin() + offset + 2 * CBLOCK), offset));
+    }
+}
+} // namespace
@@ -12,50 +12,81 @@
 #define NSRD_ASYNCINJECTION_HPP
 
 #include <functional> // std::function
-#include <chrono> // std::chrono::time_point, std::chrono::system_clock
+#include <memory> // std::shared_ptr
+#include <mutex> // std::mutex
+#include <chrono> // std::chrono::duration
 
 #include "handleton.hpp" // nsrd::Handleton
 #include "scheduler.hpp" // nsrd::Scheduler
 
 namespace nsrd
 {
+/*
+    Calls action every interval until it returns true or the injection
+    gets cancelled through the handle returned by Inject.
+*/
 class AsyncInjection
 {
+private:
+    struct State;
+
 public:
     typedef std::chrono::duration<double, std::milli> interval_t;
     typedef std::function<bool()> action_t;
 
-    static void Inject(const action_t &action, const interval_t &interval);
+    class Handle
+    {
+    public:
+        Handle();
+
+        // no call of action starts after Cancel returns,
+        // a call that is already running is not waited for
+        void Cancel();
+
+    private:
+        friend class AsyncInjection;
+
+        explicit Handle(const std::shared_ptr<State> &state);
+
+        std::shared_ptr<State> m_state;
+    };
+
+    static Handle Inject(const action_t &action, const interval_t &interval);
     
     AsyncInjection(AsyncInjection &other) = delete;
     AsyncInjection(AsyncInjection &&other) = delete;
     AsyncInjection &operator=(AsyncInjection &other) = delete;
     AsyncInjection &operator=(AsyncInjection &&other) = delete;
+    ~AsyncInjection();
     
 private:
+    struct State
+    {
+        std::mutex m_mutex;
+        bool m_is_cancelled;
+        Scheduler::Handle m_timer;
+    };
+
+    // owns the injection while it is scheduled
     class Task : public Scheduler::Task
     {
     public:
-        explicit Task(AsyncInjection &injector);
+        explicit Task(const std::shared_ptr<AsyncInjection> &injector);
         ~Task();
         
         void operator()();
         
     private:
-        AsyncInjection &m_injector;
+        std::shared_ptr<AsyncInjection> m_injector;
     };
 
-    typedef std::shared_ptr<Scheduler::Task> task_sp_t;
-    
     explicit AsyncInjection(const action_t &action, const interval_t &interval);
-    ~AsyncInjection();
     
-    void Schedule(bool reschedule = false);
-    void DeleteSelf();
+    static void Schedule(const std::shared_ptr<AsyncInjection> &injection);
     
     action_t m_action;
     interval_t m_interval;
-    task_sp_t m_task;
+    std::shared_ptr<State> m_state;
 };
 } // namespace nsrd
 
@@ -8,63 +8,71 @@
 * 
 *******************************************************************************/
 
-#include <iostream> // std::cerr, std::endl
-
 #include "async_injection.hpp" // nsrd::AsyncInjection
 
 
 using namespace nsrd;
 
-namespace
-{
-inline Scheduler::timepoint_t ComputeNewTimepoint(const AsyncInjection::interval_t &interval)
+AsyncInjection::Handle AsyncInjection::Inject(const action_t &action, const interval_t &interval)
 {
-    using namespace std::chrono;
-    return (system_clock::now() + duration_cast<system_clock::duration>(interval));
-}
-}
+    std::shared_ptr<AsyncInjection> injection(new AsyncInjection(action, interval));
+    Schedule(injection);
 
-void AsyncInjection::Inject(const action_t &action, const interval_t &interval)
-{
-    new AsyncInjection(action, interval);
+    return (Handle(injection->m_state));
 }
 
 AsyncInjection::AsyncInjection(const action_t &action, const interval_t &interval)
-    : m_action(action), m_interval(interval), m_task(new Task(*this))
+    : m_action(action), m_interval(interval), m_state(new State())
 {
-    Schedule();
+    m_state->m_is_cancelled = false;
 }
 
 AsyncInjection::~AsyncInjection()
 {}
 
-void AsyncInjection::Schedule(bool reschedule)
+void AsyncInjection::Schedule(const std::shared_ptr<AsyncInjection> &injection)
 {
-    try
-    {
-        Scheduler *scheduler = Handleton<Scheduler>::GetInstance();
-        scheduler->Add(m_task, ComputeNewTimepoint(m_interval));
-    }
-    catch(const std::exception& e)
+    State &state = *injection->m_state;
+    std::unique_lock<std::mutex> lock(state.m_mutex);
+
+    // checked under the lock Cancel takes, once cancelled it is never re-armed
+    if (state.m_is_cancelled)
     {
-        std::cerr << e.what() << std::endl;
-        DeleteSelf();
-        if (!reschedule)
-        {
-            throw e;
-        }
+        return;
     }
+
+    Scheduler *scheduler = Handleton<Scheduler>::GetInstance();
+    state.m_timer = scheduler->Add(std::shared_ptr<Scheduler::Task>(new Task(injection)),
+                                   std::chrono::duration_cast<Scheduler::duration_t>(injection->m_interval));
 }
 
-void AsyncInjection::DeleteSelf()
+/* Handle */
+/* ************************************************************************** */
+
+AsyncInjection::Handle::Handle()
+    : m_state()
+{}
+
+AsyncInjection::Handle::Handle(const std::shared_ptr<State> &state)
+    : m_state(state)
+{}
+
+void AsyncInjection::Handle::Cancel()
 {
-    delete this;
+    if (!m_state)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_state->m_mutex);
+    m_state->m_is_cancelled = true;
+    m_state->m_timer.Cancel();
 }
 
 /* Task */
 /* ************************************************************************** */
 
-AsyncInjection::Task::Task(AsyncInjection &injector)
+AsyncInjection::Task::Task(const std::shared_ptr<AsyncInjection> &injector)
     : m_injector(injector)
 {}
 
@@ -73,11 +81,21 @@ AsyncInjection::Task::~Task()
 
 void AsyncInjection::Task::operator()()
 {
-    if (m_injector.m_action())
     {
-        m_injector.DeleteSelf();
+        // the scheduler may have taken the timer off the wheel just before
+        // Cancel got to it, a call that passes here counts as started
+        State &state = *m_injector->m_state;
+        std::unique_lock<std::mutex> lock(state.m_mutex);
+        if (state.m_is_cancelled)
+        {
+            return;
+        }
+    }
+
+    if (m_injector->m_action())
+    {
         return;
     }
 
-    m_injector.Schedule(true);
-}
\ No newline at end of file
+    Schedule(m_injector);
+}
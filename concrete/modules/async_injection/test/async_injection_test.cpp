@@ -8,6 +8,10 @@
 * 
 *******************************************************************************/
 
+#include <unistd.h> // sleep
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+
 #include "testing.hpp" // testing::Testscmp, testing::UnitTest
 
 #include "handleton.hpp" // nsrd::Handleton
@@ -19,12 +23,16 @@ using namespace nsrd::testing;
 namespace
 {
 void TestGeneral();
+void TestCancel();
+void TestCancelDue();
 } // namespace
 
 int main()
 {
     Testscmp cmp;
     cmp.AddTest(UnitTest("General", TestGeneral));
+    cmp.AddTest(UnitTest("Cancel", TestCancel));
+    cmp.AddTest(UnitTest("Cancel when due", TestCancelDue));
     cmp.Run();
 
     return (0);
@@ -68,4 +76,66 @@ void TestGeneral()
 
     TH_ASSERT(15 == data);
 }
+
+void TestCancel()
+{
+    int data = 0;
+
+    AsyncInjection::Handle handle = AsyncInjection::Inject(TestAction(data, 5, 100), AsyncInjection::interval_t(1000));
+
+    SleepFor(2);
+    handle.Cancel();
+
+    int data_on_cancel = data;
+
+    SleepFor(3);
+
+    TH_ASSERT(0 < data_on_cancel);
+    TH_ASSERT(data_on_cancel == data);
+}
+
+// cancels the other injection of its pair and stops
+class CancelOther
+{
+public:
+    CancelOther(std::atomic<int> &calls, AsyncInjection::Handle &other)
+        : m_calls(calls), m_other(other) {};
+
+    bool operator()()
+    {
+        ++m_calls;
+        m_other.Cancel();
+        return (true);
+    };
+
+private:
+    std::atomic<int> &m_calls;
+    AsyncInjection::Handle &m_other;
+};
+
+void TestCancelDue()
+{
+    const std::size_t PAIRS = 20;
+
+    // injected back to back, a pair mostly falls due on the same tick, so
+    // the second is off the wheel but not yet running when the first
+    // cancels it
+    std::atomic<int> calls[PAIRS];
+    AsyncInjection::Handle handles[PAIRS][2];
+    for (std::size_t i = 0; i < PAIRS; ++i)
+    {
+        calls[i] = 0;
+        AsyncInjection::interval_t interval(100 + 20 * i);
+
+        handles[i][0] = AsyncInjection::Inject(CancelOther(calls[i], handles[i][1]), interval);
+        handles[i][1] = AsyncInjection::Inject(CancelOther(calls[i], handles[i][0]), interval);
+    }
+
+    SleepFor(2);
+
+    for (std::size_t i = 0; i < PAIRS; ++i)
+    {
+        TH_ASSERT(1 == calls[i]);
+    }
+}
 } // namespace
\ No newline at end of file
@@ -23,10 +23,12 @@ enum class MinionEventType
     START_COMMUNICATE,
     STOP_COMMUNICATE,
     RESPONSE_SUCCESS,
-    RESPONSE_FAIL
+    RESPONSE_FAIL,
+    FLUSH
 };
 
 const unsigned MINION_EVENT_MAGIC = 0xFA1AFE1;
+const std::size_t MINION_MAX_REPLY_DATA = 63 * 1024; // READ data carried by one reply datagram
 
 struct MinionEvent
 {
@@ -35,12 +37,20 @@ struct MinionEvent
     std::size_t m_event_id;
     std::size_t m_offset;
     std::size_t m_length;
+    std::size_t m_session_id;
 };
-// minion proxy can send READ, WRITE, COMMUNICATE_ONLY_WITH_ME or STOP_COMMUNICATE
+// minion proxy can send READ, WRITE, FLUSH, COMMUNICATE_ONLY_WITH_ME or STOP_COMMUNICATE
 // if minion proxy sends WRITE he should send data after it (data number of bytes == m_length)
+// minion acknowledges WRITE once the data is buffered, it is durable only after a FLUSH is acknowledged
+// every proxy socket picks its own m_session_id, minion keeps a separate session for
+// each (source address, m_session_id) pair and echoes m_session_id in its responses
+// STOP_COMMUNICATE closes only the session of the sender
 // minion can send RESPONSE_SUCCESS or RESPONSE_FAIL
-// if minion sends RESPONSE_SUCCESS on READ event, he should send data after it (data number of bytes == m_length)
-// m_offset in minion response migth be any value, it will have no effect
+// minion answers READ with datagrams that hold a RESPONSE_SUCCESS header immediately followed by
+// a piece of up to MINION_MAX_REPLY_DATA bytes of the data, the pieces splitting it at multiples
+// of MINION_MAX_REPLY_DATA; the header's m_offset is the offset of its piece, from the request's
+// m_offset on, so the pieces may be placed in whatever order they arrive
+// m_offset of any other minion response is the request's one
 
 } // namespace nsrd
 
@@ -23,6 +23,7 @@ struct NBDParams: public ICommandParams
     unsigned m_len;
     std::size_t m_offset;
     char m_event_id[8];
+    bool m_fua;
 };
 } // namespace nsrd
 
@@ -21,7 +21,7 @@ namespace nsrd
 class MinionManager
 {
 public:
-    enum CommandType {READ_CMD = 0, WRITE_CMD};
+    enum CommandType {READ_CMD = 0, WRITE_CMD, FLUSH_CMD};
     
     struct CommandParams
     {
@@ -36,6 +36,7 @@ public:
         virtual ~IMinionProxy() =0;
         virtual bool Read(CommandParams params) =0;
         virtual bool Write(CommandParams params) =0;
+        virtual bool Flush() =0; // makes every acknowledged write durable
     };
     
     void AddMinion(std::size_t minion_id, std::shared_ptr<IMinionProxy> proxy);
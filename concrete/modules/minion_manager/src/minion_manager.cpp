@@ -45,6 +45,10 @@ bool MinionManager::PerformCommand(std::size_t minion_id, MinionManager::Command
         {
             return (m_minions[minion_id].get()->Read(params));
         }
+        case (FLUSH_CMD):
+        {
+            return (m_minions[minion_id].get()->Flush());
+        }
         default:
         {
             throw std::runtime_error("Received unsupported command");
@@ -31,6 +31,7 @@ public:
 
     bool Write(nsrd::MinionManager::CommandParams params);
     bool Read(nsrd::MinionManager::CommandParams params);
+    bool Flush();
 
 private:
     std::string m_address;
@@ -77,6 +78,11 @@ bool MinionProxy::Read(nsrd::MinionManager::CommandParams params)
     return (true);
 }
 
+bool MinionProxy::Flush()
+{
+    return (true);
+}
+
 void TestMinionManager()
 {
     MinionManager *manager = nsrd::Handleton<MinionManager>::GetInstance();
@@ -110,5 +116,7 @@ void TestMinionManager()
     TH_ASSERT(std::string(buf) == std::string(buf2));
     manager->PerformCommand(3, {20, 0, buf}, MinionManager::CommandType::READ_CMD);
     TH_ASSERT(std::string(buf) == std::string(buf3));
+
+    TH_ASSERT(manager->PerformCommand(0, {0, 0, nullptr}, MinionManager::CommandType::FLUSH_CMD));
 }
 } // namespace
\ No newline at end of file
@@ -12,7 +12,6 @@
 #define NSRD_MINION_PROXY_HPP
 
 #include <mutex> // std::timed_mutex
-#include <memory> // std::shared_ptr
 #include <sys/socket.h> // sockaddr
 
 #include "minion_event.hpp" // nsrd::MinionEventType, nsrd::MinionEvent
@@ -20,7 +19,10 @@
 
 namespace nsrd
 {
-
+/*
+    Every proxy opens its own session on the minion, so any number of proxies
+    (of the same or different masters) may talk to one minion at the same time.
+*/
 class MinionProxy: public MinionManager::IMinionProxy
 {
 public:
@@ -29,6 +31,7 @@ public:
 
     bool Read(MinionManager::CommandParams params);
     bool Write(MinionManager::CommandParams params);
+    bool Flush();
 
     MinionProxy(const MinionProxy &) =delete;
     MinionProxy(const MinionProxy &&) =delete;
@@ -42,6 +45,7 @@ private:
     int m_proxy_socket;
     std::mutex m_mutex;
     sockaddr m_proxy_sa;
+    std::size_t m_session_id;
     std::size_t m_ids_counter;
 
     void ConnectToMinion();
@@ -51,13 +55,15 @@ private:
     bool Read(const MinionEvent &request, void *buf = nullptr);
     bool SendData(void *buf, std::size_t length);
     bool ReadData(void *buf, std::size_t length);
+    bool ReadReply(const MinionEvent &request, char *buf);
+    bool IsFromMinion(const sockaddr &from_sa) const;
     std::size_t GetNewCmdId();
+    void InitRequest(MinionEvent *event, nsrd::MinionEventType type, std::size_t offset, std::size_t length);
 
     class CheckResponse
     {
     public:
-        CheckResponse(std::shared_ptr<bool> shouldnt_reschedule,
-                      MinionProxy *m_proxy,
+        CheckResponse(MinionProxy *m_proxy,
                       MinionEvent event,
                       void *buf);
         ~CheckResponse();
@@ -65,7 +71,6 @@ private:
         bool operator()();
 
     private:
-        std::shared_ptr<bool> m_shouldnt_reschedule;
         MinionProxy *m_proxy;
         MinionEvent m_event;
         void *m_buf;
@@ -13,6 +13,10 @@
 #include <cstring> // std::strerror
 #include <unistd.h> // close
 #include <ifaddrs.h> // getifaddrs
+#include <sys/uio.h> // iovec
+#include <random> // std::random_device
+#include <vector> // std::vector
+#include <algorithm> // std::min, std::max
 
 #include "handleton.hpp" // nsrd::Handleton
 #include "async_injection.hpp" // nsrd::AsyncInjection
@@ -28,8 +32,10 @@ const std::size_t MAX_ATTEMPTS = 15;
 void InitSockaddr(struct sockaddr *sa, const char *addr, unsigned short port);
 void InitEvent(MinionEvent *event, std::size_t cmd_id, nsrd::MinionEventType type, std::size_t offset, std::size_t length);
 std::string FindLocalIp();
+std::size_t GenerateSessionId();
 void CleanUpSocket(int socket);
 bool IsResponceValid(const MinionEvent &request, const MinionEvent &responce);
+bool IsReplyValid(const MinionEvent &request, const MinionEvent &reply);
 } // namespace
 
 MinionProxy::MinionProxy(const std::string &minion_ip, unsigned short minion_port)
@@ -38,6 +44,8 @@ MinionProxy::MinionProxy(const std::string &minion_ip, unsigned short minion_por
       m_minion_sa(),
       m_proxy_socket(0),
       m_mutex(),
+      m_proxy_sa(),
+      m_session_id(GenerateSessionId()),
       m_ids_counter(0)
 {
     InitSockaddr(&m_minion_sa, m_minion_ip.c_str(), m_minion_port);
@@ -58,23 +66,22 @@ bool MinionProxy::Write(MinionManager::CommandParams params)
     CleanUpSocket(m_proxy_socket);
 
     MinionEvent request;
-    InitEvent(&request, GetNewCmdId(), nsrd::MinionEventType::WRITE, params.offset, params.length);
+    InitRequest(&request, nsrd::MinionEventType::WRITE, params.offset, params.length);
 
     if (!Send(request, params.buffer))
     {
         return (false);
     }
 
-    std::shared_ptr<bool> shouldnt_reschedule(new bool(false));
-    AsyncInjection::Inject(CheckResponse(shouldnt_reschedule, this, request, params.buffer), CHECK_INTERVAL);
+    AsyncInjection::Handle retransmission = AsyncInjection::Inject(CheckResponse(this, request, params.buffer), CHECK_INTERVAL);
 
     if(!Read(request))
     {
-        *shouldnt_reschedule = true;
+        retransmission.Cancel();
         return (false);
     }
 
-    *shouldnt_reschedule = true;
+    retransmission.Cancel();
     return (true);
 }
 
@@ -85,23 +92,48 @@ bool MinionProxy::Read(MinionManager::CommandParams params)
     CleanUpSocket(m_proxy_socket);
 
     MinionEvent request;
-    InitEvent(&request, GetNewCmdId(), nsrd::MinionEventType::READ, params.offset, params.length);
+    InitRequest(&request, nsrd::MinionEventType::READ, params.offset, params.length);
 
     if (!Send(request))
     {
         return (false);
     }
 
-    std::shared_ptr<bool> shouldnt_reschedule(new bool(false));
-    AsyncInjection::Inject(CheckResponse(shouldnt_reschedule, this, request, nullptr), CHECK_INTERVAL);
+    AsyncInjection::Handle retransmission = AsyncInjection::Inject(CheckResponse(this, request, nullptr), CHECK_INTERVAL);
 
     if (!Read(request, params.buffer))
     {
-        *shouldnt_reschedule = true;
+        retransmission.Cancel();
         return (false);
     }
     
-    *shouldnt_reschedule = true;
+    retransmission.Cancel();
+    return (true);
+}
+
+bool MinionProxy::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    CleanUpSocket(m_proxy_socket);
+
+    MinionEvent request;
+    InitRequest(&request, nsrd::MinionEventType::FLUSH, 0, 0);
+
+    if (!Send(request))
+    {
+        return (false);
+    }
+
+    AsyncInjection::Handle retransmission = AsyncInjection::Inject(CheckResponse(this, request, nullptr), CHECK_INTERVAL);
+
+    if (!Read(request))
+    {
+        retransmission.Cancel();
+        return (false);
+    }
+
+    retransmission.Cancel();
     return (true);
 }
 
@@ -113,12 +145,19 @@ void MinionProxy::OpenProxySocket()
         throw std::runtime_error("Couldn't open proxy socket");
     }
 
-    InitSockaddr(&m_proxy_sa, FindLocalIp().c_str(), m_minion_port + 1);
+    // any free port, so several proxies can live on the same host
+    InitSockaddr(&m_proxy_sa, FindLocalIp().c_str(), 0);
 
     if (-1 == bind(m_proxy_socket, &m_proxy_sa, INET_ADDRSTRLEN))
     {
         throw std::runtime_error("Couldn't bind proxy socket");
-    }   
+    }
+
+    socklen_t proxy_sa_len = sizeof(sockaddr);
+    if (-1 == getsockname(m_proxy_socket, &m_proxy_sa, &proxy_sa_len))
+    {
+        throw std::runtime_error("Couldn't get proxy socket address");
+    }
 }
 
 void MinionProxy::ConnectToMinion()
@@ -128,23 +167,22 @@ void MinionProxy::ConnectToMinion()
     CleanUpSocket(m_proxy_socket);
     
     MinionEvent request;
-    InitEvent(&request, GetNewCmdId(), nsrd::MinionEventType::START_COMMUNICATE, 0, 0);
+    InitRequest(&request, nsrd::MinionEventType::START_COMMUNICATE, 0, 0);
 
     if (!Send(request))
     {
         throw std::runtime_error("Couldn't connect to the minion");
     }
 
-    std::shared_ptr<bool> shouldnt_reschedule(new bool(false));
-    AsyncInjection::Inject(CheckResponse(shouldnt_reschedule, this, request, nullptr), CHECK_INTERVAL);
+    AsyncInjection::Handle retransmission = AsyncInjection::Inject(CheckResponse(this, request, nullptr), CHECK_INTERVAL);
 
     if (!Read(request))
     {
-        *shouldnt_reschedule = true;
+        retransmission.Cancel();
         throw std::runtime_error("Couldn't connect to the minion");
     }
 
-    *shouldnt_reschedule = true;
+    retransmission.Cancel();
 }
 
 void MinionProxy::StopCommunicate()
@@ -152,7 +190,7 @@ void MinionProxy::StopCommunicate()
     std::unique_lock<std::mutex> lock(m_mutex);
 
     MinionEvent request;
-    InitEvent(&request, GetNewCmdId(), nsrd::MinionEventType::STOP_COMMUNICATE, request.m_offset, request.m_length);
+    InitRequest(&request, nsrd::MinionEventType::STOP_COMMUNICATE, 0, 0);
 
     if (!Send(request))
     {
@@ -163,49 +201,47 @@ void MinionProxy::StopCommunicate()
 
 /* Checkresponse */
 /* ************************************************************************** */
-MinionProxy::CheckResponse::CheckResponse(std::shared_ptr<bool> shouldnt_reschedule,
-                                          MinionProxy *m_proxy,
+MinionProxy::CheckResponse::CheckResponse(MinionProxy *m_proxy,
                                           MinionEvent event,
                                           void *buf)
-    : m_shouldnt_reschedule(shouldnt_reschedule),
-      m_proxy(m_proxy),
+    : m_proxy(m_proxy),
       m_event(),
       m_buf(buf),
       m_attempts_counter(0)
 {
     InitEvent(&m_event, event.m_event_id, event.m_type, event.m_offset, event.m_length);
+    m_event.m_session_id = event.m_session_id;
 }
 
 MinionProxy::CheckResponse::~CheckResponse()
 {}
 
+// retransmits until the request thread cancels the injection,
+// returns true once it gives up
 bool MinionProxy::CheckResponse::operator()()
 {
-    if (false == *m_shouldnt_reschedule)
+    if (MAX_ATTEMPTS != m_attempts_counter++ && m_proxy->Send(m_event, m_buf))
     {
-        if (MAX_ATTEMPTS == m_attempts_counter++ || !m_proxy->Send(m_event, m_buf))
-        {
-            *m_shouldnt_reschedule = true;
-            
-            if (MAX_ATTEMPTS == m_attempts_counter)
-            {
-                std::cerr << "Reached max_attempts to retransmit" << std::endl;
-            }
-            else
-            {
-                std::cerr << "Injection failed to retransmit" << std::endl;
-            }
-
-            MinionEvent event;
-            InitEvent(&event, m_proxy->GetNewCmdId(), nsrd::MinionEventType::RESPONSE_FAIL, 0, 0);
-            if (-1 == send(m_proxy->m_proxy_socket, &event, sizeof(MinionEvent), 0))
-            {
-                std::cerr << "Failed sending RESPONSE_FAIL " << std::strerror(errno) << std::endl;
-            }
-        }
+        return (false);
+    }
+
+    if (MAX_ATTEMPTS == m_attempts_counter)
+    {
+        std::cerr << "Reached max_attempts to retransmit" << std::endl;
+    }
+    else
+    {
+        std::cerr << "Injection failed to retransmit" << std::endl;
+    }
+
+    MinionEvent event;
+    InitEvent(&event, m_proxy->GetNewCmdId(), nsrd::MinionEventType::RESPONSE_FAIL, 0, 0);
+    if (-1 == send(m_proxy->m_proxy_socket, &event, sizeof(MinionEvent), 0))
+    {
+        std::cerr << "Failed sending RESPONSE_FAIL " << std::strerror(errno) << std::endl;
     }
 
-    return (*m_shouldnt_reschedule);
+    return (true);
 }
 
 bool MinionProxy::Send(const MinionEvent &request, void *buf)
@@ -227,41 +263,103 @@ bool MinionProxy::Send(const MinionEvent &request, void *buf)
 
 bool MinionProxy::Read(const MinionEvent &request, void *buf)
 {
-    MinionEvent response;
+    if (request.m_type == nsrd::MinionEventType::READ)
+    {
+        return (ReadReply(request, static_cast<char *>(buf)));
+    }
 
-    bool status = false;
+    MinionEvent response;
 
     while (true)
     {
-        status = ReadData(&response, sizeof(MinionEvent))
-                  && nsrd::MinionEventType::RESPONSE_FAIL != response.m_type
-                  && IsResponceValid(request, response);
+        if (ReadData(&response, sizeof(MinionEvent)) && IsResponceValid(request, response))
+        {
+            return (nsrd::MinionEventType::RESPONSE_FAIL != response.m_type);
+        }
+
+        CleanUpSocket(m_proxy_socket);
+    }
+}
+
+bool MinionProxy::ReadReply(const MinionEvent &request, char *buf)
+{
+    MinionEvent response;
+    sockaddr from_sa = {0, {0}};
+
+    // the pieces split the data at multiples of MINION_MAX_REPLY_DATA, an
+    // empty reply is a single empty piece
+    std::size_t pieces_num = std::max((request.m_length + MINION_MAX_REPLY_DATA - 1) /
+                                      MINION_MAX_REPLY_DATA, std::size_t(1));
+    std::vector<bool> is_arrived(pieces_num, false);
+    std::size_t next_missing = 0;
+
+    // every datagram is read in place of the first piece missing, where the
+    // next one in order belongs; a piece that came out of order is moved to
+    // its own place from there
+    while (next_missing < pieces_num)
+    {
+        std::size_t slot_pos = next_missing * MINION_MAX_REPLY_DATA;
+        std::size_t slot_length = std::min(request.m_length - slot_pos, MINION_MAX_REPLY_DATA);
+        iovec iov[2] = {{&response, sizeof(MinionEvent)}, {buf + slot_pos, slot_length}};
+
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msghdr));
+        msg.msg_name = &from_sa;
+        msg.msg_namelen = sizeof(sockaddr);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+
+        ssize_t bytes_read = recvmsg(m_proxy_socket, &msg, 0);
+        if (0 > bytes_read)
+        {
+            if (errno == EINTR){ continue; }
+            std::cerr << std::strerror(errno) << std::endl;
+            std::cerr << "ReadReply has failed" << std::endl;
+            return (false);
+        }
 
-        if (status && request.m_type != nsrd::MinionEventType::READ)
+        if (!IsFromMinion(from_sa) || sizeof(MinionEvent) > static_cast<std::size_t>(bytes_read))
         {
-            return (status);
+            continue;
         }
 
-        if (status && request.m_type == nsrd::MinionEventType::READ)
+        if (!IsReplyValid(request, response))
         {
-            status = ReadData(buf, request.m_length)
-                  && ReadData(&response, sizeof(MinionEvent))
-                  && IsResponceValid(request, response);
-
-            if (status && nsrd::MinionEventType::RESPONSE_FAIL == response.m_type)
-            {
-                std::cerr << "Received response fail" << std::endl;
-                return (false);
-            }
-
-            if (status)
-            {
-                return (status);
-            }
+            // a stale reply, it might have scribbled over the missing piece only
+            continue;
         }
 
-        CleanUpSocket(m_proxy_socket);
+        if (nsrd::MinionEventType::RESPONSE_FAIL == response.m_type)
+        {
+            std::cerr << "Received response fail" << std::endl;
+            return (false);
+        }
+
+        std::size_t piece_pos = response.m_offset - request.m_offset;
+        std::size_t piece_idx = piece_pos / MINION_MAX_REPLY_DATA;
+        std::size_t piece_length = std::min(request.m_length - piece_pos, MINION_MAX_REPLY_DATA);
+
+        // truncated, or a duplicate
+        if (piece_length != static_cast<std::size_t>(bytes_read) - sizeof(MinionEvent)
+         || is_arrived[piece_idx])
+        {
+            continue;
+        }
+
+        if (piece_idx != next_missing)
+        {
+            // a later piece, the slot it was read to is a full one
+            std::memcpy(buf + piece_pos, buf + slot_pos, piece_length);
+        }
+
+        is_arrived[piece_idx] = true;
+        while (next_missing < pieces_num && is_arrived[next_missing])
+        {
+            ++next_missing;
+        }
     }
+
+    return (true);
 }
 
 bool MinionProxy::SendData(void *buf, std::size_t length)
@@ -307,8 +405,7 @@ bool MinionProxy::ReadData(void *buf, std::size_t length)
             return (false);
         }
 
-        if (0 != std::memcmp(from_sa.sa_data, m_minion_sa.sa_data, 14)
-         && 0 != std::memcmp(from_sa.sa_data, m_proxy_sa.sa_data, 14))
+        if (!IsFromMinion(from_sa))
         {
             std::cerr << "Received data is not from the current minion" << std::endl;
             return (false);
@@ -322,11 +419,23 @@ bool MinionProxy::ReadData(void *buf, std::size_t length)
 }
 
 
+bool MinionProxy::IsFromMinion(const sockaddr &from_sa) const
+{
+    return (0 == std::memcmp(from_sa.sa_data, m_minion_sa.sa_data, 14)
+         || 0 == std::memcmp(from_sa.sa_data, m_proxy_sa.sa_data, 14));
+}
+
 std::size_t MinionProxy::GetNewCmdId()
 {
     return (m_ids_counter += 2);
 }
 
+void MinionProxy::InitRequest(MinionEvent *event, nsrd::MinionEventType type, std::size_t offset, std::size_t length)
+{
+    InitEvent(event, GetNewCmdId(), type, offset, length);
+    event->m_session_id = m_session_id;
+}
+
 namespace
 {
 void InitSockaddr(struct sockaddr *sa, const char *addr, unsigned short port)
@@ -381,6 +490,19 @@ std::string FindLocalIp()
     return (ip);
 }
 
+std::size_t GenerateSessionId()
+{
+    std::random_device device;
+    std::size_t session_id = 0;
+
+    while (0 == session_id)
+    {
+        session_id = (static_cast<std::size_t>(device()) << 32) | device();
+    }
+
+    return (session_id);
+}
+
 void CleanUpSocket(int socket)
 {
     char buffer[1024];
@@ -395,8 +517,23 @@ void CleanUpSocket(int socket)
 bool IsResponceValid(const MinionEvent &request, const MinionEvent &responce)
 {
     return (request.m_event_id == responce.m_event_id
+         && request.m_session_id == responce.m_session_id
          && request.m_length == responce.m_length
          && request.m_offset == responce.m_offset
          && request.m_magic == responce.m_magic);
 }
+
+// a piece of the reply to a READ, at its place in the requested range
+bool IsReplyValid(const MinionEvent &request, const MinionEvent &reply)
+{
+    std::size_t piece_pos = reply.m_offset - request.m_offset;
+
+    return (request.m_event_id == reply.m_event_id
+         && request.m_session_id == reply.m_session_id
+         && request.m_length == reply.m_length
+         && request.m_magic == reply.m_magic
+         && request.m_offset <= reply.m_offset
+         && (0 == piece_pos || piece_pos < request.m_length)
+         && 0 == piece_pos % MINION_MAX_REPLY_DATA);
+}
 } // namespace
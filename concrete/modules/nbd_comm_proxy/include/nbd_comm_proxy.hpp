@@ -19,7 +19,8 @@ namespace nsrd
 class NBDCommProxy
 {
 public:
-    static void SetNBDCommProxy(const std::string &dev_file_path, std::size_t nbd_size) noexcept;
+    static void SetNBDCommProxy(const std::string &dev_file_path, std::size_t nbd_size,
+                                const Placement &placement = Placement()) noexcept;
 
     NBDCommProxy(const NBDCommProxy &) = delete;
     NBDCommProxy(NBDCommProxy&&) = delete;
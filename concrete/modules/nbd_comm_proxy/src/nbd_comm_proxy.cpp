@@ -18,11 +18,12 @@ template class nsrd::Handleton<nsrd::NBDCommProxy>;
 
 nsrd::NBDCommunicator *nsrd::NBDCommProxy::s_nbd = nullptr;
 
-void nsrd::NBDCommProxy::SetNBDCommProxy(const std::string &dev_file_path, std::size_t nbd_size) noexcept
+void nsrd::NBDCommProxy::SetNBDCommProxy(const std::string &dev_file_path, std::size_t nbd_size,
+                                         const Placement &placement) noexcept
 {
     try
     {
-        s_nbd = new NBDCommunicator(dev_file_path, nbd_size);
+        s_nbd = new NBDCommunicator(dev_file_path, nbd_size, placement);
     }
     catch (const NBDCommunicator::NBDCommOpenChannelsExc &e)
     {
@@ -18,12 +18,14 @@
 #include <unordered_map> // std::unordered_map
 #include <functional> // std::function, std::bind
 
+#include "placement.hpp" // nsrd::Placement
+
 namespace nsrd
 {
 class NBDCommunicator
 {
 public:
-    enum EventType: int {READ, WRITE};
+    enum EventType: int {READ, WRITE, FLUSH};
 
     struct Event
     {
@@ -31,6 +33,7 @@ public:
         std::size_t m_offset;
         unsigned m_length;
         char m_event_id[8];
+        bool m_fua; // WRITE must be durable before it is replied
     }; 
 
     enum StatusType 
@@ -47,7 +50,10 @@ public:
         const char *what() const noexcept;
     };
 
-    explicit NBDCommunicator(const std::string &dev_file_path, std::size_t nbd_size);
+    // the server thread is placed as the placement's thread 0, the
+    // translator as its thread 1
+    explicit NBDCommunicator(const std::string &dev_file_path, std::size_t nbd_size,
+                             const Placement &placement = Placement());
     ~NBDCommunicator() noexcept;
 
     NBDCommunicator(NBDCommunicator &) = delete;
@@ -71,6 +77,7 @@ private:
     enum NBD_COMM_STATUS {NBD_COMM_FAILURE = -1, NBD_COMM_SUCCESS};
     enum NBD_COMM_SOCKETS {SERVER_SOCK, TRANSLATOR_SOCK, NBD_COMM_SOCKETS_AMOUNT};
     enum COMM_SOCKETS {FROM_COMMUNICATOR_SOCK, TO_USER_SOCK, COMM_SOCKETS_AMOUNT};
+    enum NBD_COMM_THREADS {SERVER_THREAD, TRANSLATOR_THREAD};
     enum NBD_RES_STATUS_CODES
     {
         NBD_SUCCESS = 0, 
@@ -88,6 +95,7 @@ private:
     int m_nbd_sockets[NBD_COMM_SOCKETS_AMOUNT];
     int m_comm_sockets[COMM_SOCKETS_AMOUNT];
     std::mutex m_reply_mutex;
+    Placement m_placement;
 
     std::thread m_nbd_server_thread;
     std::thread m_nbd_translator_thread;
@@ -102,6 +110,7 @@ private:
 
     NBD_COMM_STATUS HandleRead(const nbd_request_t &request);
     NBD_COMM_STATUS HandleWrite(const nbd_request_t &request);
+    NBD_COMM_STATUS HandleFlush(const nbd_request_t &request);
     void HandleDisc() noexcept;
 
     void StopCommunicator() noexcept;
@@ -30,19 +30,22 @@ using namespace nsrd;
 
 namespace
 {
+const uint32_t NBD_CMD_MASK = 0x0000ffff;
 int WriteData(int fd, const char *buf, std::size_t count);
 int ReadData(int fd, char *buf, std::size_t count);
 u_int64_t ntohll(u_int64_t a);
 #define htonll ntohll
 } // anonimus
 
-NBDCommunicator::NBDCommunicator(const std::string &dev_file_path, std::size_t nbd_size)
+NBDCommunicator::NBDCommunicator(const std::string &dev_file_path, std::size_t nbd_size,
+                                 const Placement &placement)
     : m_dev_file_path(dev_file_path),
       m_nbd_size(nbd_size),
       m_nbd_fd(),
       m_nbd_sockets(),
       m_comm_sockets(),
       m_reply_mutex(),
+      m_placement(placement),
       m_nbd_server_thread(),
       m_nbd_translator_thread()
 {
@@ -150,6 +153,12 @@ NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::SetupChannels()
         return (NBD_COMM_FAILURE);
     }
 
+    if (-1 == ioctl(m_nbd_fd, NBD_SET_FLAGS, NBD_FLAG_HAS_FLAGS | NBD_FLAG_SEND_FLUSH | NBD_FLAG_SEND_FUA))
+    {
+        std::cerr << "[Error] SetupChannels: NBD_SET_FLAGS" << std::endl;
+        return (NBD_COMM_FAILURE);
+    }
+
     if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, m_nbd_sockets))
     {
         std::cerr << "[Error] SetupChannels: socketpair" << std::endl;
@@ -176,6 +185,11 @@ void NBDCommunicator::ServerDriver()
         std::cerr << "[Error] ServerDriver: pthread_sigmask error" << std::endl;
     }
 
+    if (!m_placement.Apply(SERVER_THREAD))
+    {
+        std::cerr << "[Warning] ServerDriver: couldn't place the thread" << std::endl;
+    }
+
     if(-1 == ioctl(m_nbd_fd, NBD_SET_SOCK, m_nbd_sockets[SERVER_SOCK]))
     {
         StopCommunicator();
@@ -205,6 +219,11 @@ void NBDCommunicator::TranslatorDriver()
         std::cerr << "[Error] TranslatorDriver: pthread_sigmask error" << std::endl;
     }
 
+    if (!m_placement.Apply(TRANSLATOR_THREAD))
+    {
+        std::cerr << "[Warning] TranslatorDriver: couldn't place the thread" << std::endl;
+    }
+
     nbd_request_t request;
 
     while (true)
@@ -216,7 +235,7 @@ void NBDCommunicator::TranslatorDriver()
             return;
         }
 
-        uint32_t req_type = ntohl(request.type);
+        uint32_t req_type = ntohl(request.type) & NBD_CMD_MASK;
 
         if (NBD_CMD_DISC == req_type)
         {
@@ -224,7 +243,8 @@ void NBDCommunicator::TranslatorDriver()
             return;
         }
         else if ((NBD_CMD_READ == req_type && NBD_COMM_FAILURE == HandleRead(request))
-               ||(NBD_CMD_WRITE == req_type && NBD_COMM_FAILURE == HandleWrite(request)))
+               ||(NBD_CMD_WRITE == req_type && NBD_COMM_FAILURE == HandleWrite(request))
+               ||(NBD_CMD_FLUSH == req_type && NBD_COMM_FAILURE == HandleFlush(request)))
         {
             StopCommunicator();
             return;
@@ -244,7 +264,7 @@ NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::HandleRead(const nbd_request_t
         return (NBD_COMM_FAILURE);
     }
 
-    Event event({req_type, from, len, {0}});
+    Event event({req_type, from, len, {0}, false});
     std::memcpy(event.m_event_id, request.handle, sizeof(request.handle));
 
     if (-1 == write(m_comm_sockets[FROM_COMMUNICATOR_SOCK], &event, sizeof(Event)))
@@ -269,7 +289,7 @@ NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::HandleWrite(const nbd_request_
         return (NBD_COMM_FAILURE);
     }
 
-    Event event({req_type, from, len, {0}});
+    Event event({req_type, from, len, {0}, 0 != (ntohl(request.type) & NBD_CMD_FLAG_FUA)});
     std::memcpy(event.m_event_id, request.handle, sizeof(request.handle));
 
     char *chunk = static_cast<char *>(operator new(len));
@@ -303,6 +323,12 @@ NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::HandleWrite(const nbd_request_
     return (NBD_COMM_SUCCESS);
 }
 
+NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::HandleFlush(const nbd_request_t &request)
+{
+    // flush carries no payload, so it travels exactly like a read request
+    return (HandleRead(request));
+}
+
 void NBDCommunicator::HandleDisc() noexcept
 {
     close(m_nbd_sockets[TRANSLATOR_SOCK]);
@@ -310,7 +336,7 @@ void NBDCommunicator::HandleDisc() noexcept
 
 NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::TranslateReqType(uint32_t nbd_type, EventType &event_type)
 {
-    switch (nbd_type)
+    switch (nbd_type & NBD_CMD_MASK)
     {
         case (NBD_CMD_READ):
         {
@@ -322,6 +348,11 @@ NBDCommunicator::NBD_COMM_STATUS NBDCommunicator::TranslateReqType(uint32_t nbd_
             event_type = WRITE;
             return (NBD_COMM_SUCCESS);
         }
+        case (NBD_CMD_FLUSH):
+        {
+            event_type = FLUSH;
+            return (NBD_COMM_SUCCESS);
+        }
         default:
         {
             std::cerr << "[Error] TranslateReqType: unsupported type" << std::endl;
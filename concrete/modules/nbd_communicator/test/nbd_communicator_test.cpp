@@ -105,6 +105,7 @@ void TestNBD()
     struct pollfd *pfd = new struct pollfd({nbd_fd, POLLIN, 0});
     
     bool stop = false;
+    std::size_t flushes = 0;
     std::thread stop_thread = std::thread(&ClosingDriver, &stop);
 
     sleep(2);
@@ -150,12 +151,25 @@ void TestNBD()
 
                     break;
                 }
+
+                case (NBDCommunicator::FLUSH):
+                {
+                    // e.g. after 'sync', the writes replied to are in data already
+                    TH_ASSERT(0 == len); // nothing follows it on the fd
+
+                    ++flushes;
+                    nbd.Reply(NBDCommunicator::StatusType::SUCCESS, event.m_event_id);
+
+                    break;
+                }
             }
         }
     }
     
     stop_thread.join();
 
+    std::cout << "Flushes replied: " << flushes << std::endl;
+
     operator delete(data);
 
     delete pfd;
@@ -51,6 +51,7 @@ public:
     */
     typedef std::function<bool(std::size_t minion_idx, const CommandParams &params)> write_callback_t;
     typedef std::function<bool(std::size_t minion_idx, CommandParams *params)> read_callback_t;
+    typedef std::function<bool(std::size_t minion_idx)> flush_callback_t;
     
     /*
         Calls write_callback amount of minions times in a loop 
@@ -65,6 +66,19 @@ public:
         Returns failure if 1 read failed from main storage minion and its mirror.
     */
     bool Read(CommandParams params, read_callback_t *callback);
+
+    /*
+        Calls flush_callback for every minion, mirrors included,
+        so that all acknowledged writes become durable.
+        Returns failure if at least 1 flush_callback fails.
+    */
+    bool Flush(flush_callback_t *callback);
+
+    /*
+        Returns the size of a stripe: a block on each of the main storage
+        minions, the unit the device is spread over them in.
+    */
+    std::size_t GetStripeSize() const;
     
     RaidManager(const RaidManager &) =delete;
     RaidManager(const RaidManager &&) =delete;
@@ -84,6 +84,23 @@ bool RaidManager::Read(RaidManager::CommandParams params, RaidManager::read_call
     return (status);
 }
 
+bool RaidManager::Flush(flush_callback_t *callback)
+{
+    bool status = true;
+
+    for (std::size_t i = 0; i < m_minion_count; ++i)
+    {
+        status = callback->operator()(i) && status;
+    }
+
+    return (status);
+}
+
+std::size_t RaidManager::GetStripeSize() const
+{
+    return (BLOCK_SIZE * m_mirrors_first_idx);
+}
+
 void RaidManager::SetMinionCount(std::size_t count)
 {
     RaidManager::MINION_COUNT = count;
@@ -28,9 +28,12 @@ public:
 
     bool operator()(const RaidManager::CommandParams &params);
     bool operator()(RaidManager::CommandParams *params);
+    bool operator()();
+    std::size_t GetFlushes() const;
 
 private:
     std::shared_ptr<char> m_storage;
+    std::size_t m_flushes;
 };
 void TestRaidManager();
 } // namespace
@@ -83,12 +86,36 @@ void TestRaidManager()
     manager->Read({48, 0, arr_to_read}, &read_handler);
 
     TH_ASSERT(std::string(arr_to_write) == std::string(arr_to_read));
+
+    RaidManager::flush_callback_t flush_handler = [&](std::size_t minion_idx)->bool
+    {
+        return (minions[minion_idx]());
+    };
+
+    TH_ASSERT(manager->Flush(&flush_handler));
+
+    for (std::size_t i = 0; i < 6; ++i)
+    {
+        TH_ASSERT(1 == minions[i].GetFlushes());
+    }
 }
 
 Minion::Minion(std::size_t storage_size)
-    : m_storage(static_cast<char *>(operator new(storage_size)))
+    : m_storage(static_cast<char *>(operator new(storage_size))),
+      m_flushes(0)
 {}
 
+bool Minion::operator()()
+{
+    ++m_flushes;
+    return (true);
+}
+
+std::size_t Minion::GetFlushes() const
+{
+    return (m_flushes);
+}
+
 bool Minion::operator()(const RaidManager::CommandParams &params)
 {
     std::cout << "    offset = " << params.offset << std::endl;
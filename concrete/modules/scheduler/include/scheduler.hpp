@@ -1,32 +1,49 @@
 /*******************************************************************************
 *
 * FILENAME : scheduler.cpp
-* 
+*
 * AUTHOR : Nick Shenderov
 *
 * DATE : 03.10.2023
-* 
+*
+* Tasks are kept in a hierarchical timing wheel with a 1 ms tick: 4 levels of
+* 64 slots, each level's slot covering a whole rotation of the level below.
+* A task is put into the level that its distance from the current tick
+* falls into and is moved down a level when the wheel reaches its slot.
+* Add is O(1) and takes no syscall.
+*
+* A single scheduler thread sleeps until the nearest non-empty slot and runs
+* the due tasks on itself, so tasks must be short; they may call Add.
+*
+* Add returns a handle; its Cancel takes the task out of the wheel at once
+* unless the task has already been started.
+*
+* Deadlines are steady_clock time points, or delays from now, so wall clock
+* adjustments never fire or stall the tasks.
+*
 *******************************************************************************/
 
 #ifndef NSRD_SCHEDULER_HPP
 #define NSRD_SCHEDULER_HPP
 
 #include <memory> //std::shared_ptr
-#include <chrono> // std::chrono::time_point, std::chrono::system_clock
+#include <chrono> // std::chrono::steady_clock
+#include <list> // std::list
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <cstdint> // uint64_t
 
-#include "pqueue.hpp" // nsrd::PriorityQueue
-#include "waitable_queue.hpp" // nsrd::WaitableQueue
 #include "handleton.hpp" // nsrd::Handleton
 
-#include <csignal>
-
 namespace nsrd
 {
 class Scheduler
 {
 public:
-    typedef std::chrono::time_point<std::chrono::system_clock> timepoint_t;
-    
+    typedef std::chrono::steady_clock::time_point timepoint_t;
+    typedef std::chrono::steady_clock::duration duration_t;
+
     class Task
     {
     public:
@@ -35,19 +52,83 @@ public:
         virtual void operator()() =0;
     };
 
+    class Handle;
+
     Scheduler(Scheduler &other) = delete;
     Scheduler(Scheduler &&other) = delete;
     Scheduler &operator=(Scheduler &other) = delete;
     Scheduler &operator=(Scheduler &&other) = delete;
 
-    void Add(std::shared_ptr<Task> task, timepoint_t deadline);
+    Handle Add(std::shared_ptr<Task> task, timepoint_t deadline);
+    Handle Add(std::shared_ptr<Task> task, duration_t delay);
 
 private:
     friend class Handleton<Scheduler>;
+    friend class Handle;
+
+    typedef uint64_t tick_t;
+    typedef std::chrono::milliseconds tick_duration_t;
+
+    static const std::size_t LEVEL_BITS = 6;
+    static const std::size_t SLOTS = 1 << LEVEL_BITS;
+    static const std::size_t LEVELS = 4;
+
+    struct Link;
+
+    struct Timer
+    {
+        std::shared_ptr<Task> m_task;
+        tick_t m_expiry;
+        std::shared_ptr<Link> m_link;
+    };
+
+    typedef std::list<Timer> slot_t;
+
+    // where a pending timer currently is, m_slot is null once it was taken out
+    struct Link
+    {
+        slot_t *m_slot;
+        slot_t::iterator m_pos;
+    };
+
+    slot_t m_wheel[LEVELS][SLOTS];
+    std::size_t m_timers_count;
+    tick_t m_current; // the next tick to be processed
+    tick_t m_wake_tick;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_run;
+    std::thread m_thread;
 
     Scheduler();
     ~Scheduler() noexcept;
+
+    tick_t NowTick() const;
+    void Place(slot_t &from, slot_t::iterator timer);
+    void Cascade(tick_t tick);
+    tick_t NextWakeTick() const;
+    void Run();
+    bool Cancel(const std::weak_ptr<Link> &link);
+};
+
+class Scheduler::Handle
+{
+public:
+    Handle();
+
+    // returns false if the task has already been started or cancelled
+    bool Cancel();
+
+private:
+    friend class Scheduler;
+
+    Handle(Scheduler *scheduler, const std::shared_ptr<Link> &link);
+
+    Scheduler *m_scheduler;
+    std::weak_ptr<Link> m_link;
 };
 }
 
-#endif // NSRD_SCHEDULER_HPP       
\ No newline at end of file
+#endif // NSRD_SCHEDULER_HPP
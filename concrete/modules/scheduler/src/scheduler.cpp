@@ -1,16 +1,15 @@
 /*******************************************************************************
 *
 * FILENAME : scheduler.cpp
-* 
+*
 * AUTHOR : Nick Shenderov
 *
 * DATE : 03.10.2023
-* 
+*
 *******************************************************************************/
 
 #include <iostream> // std::cerr, std::endl
-#include <cstring> // std::strerror(errno), std::memset
-#include <time.h> // timer_create, timer_delete
+#include <limits> // std::numeric_limits
 
 #include "scheduler.hpp" // nsrd::Scheduler
 
@@ -18,101 +17,256 @@ using namespace nsrd;
 
 namespace
 {
-typedef std::pair<timer_t, std::shared_ptr<Scheduler::Task> > scheduled_task_t;
-typedef Scheduler::Task task_t;
+const uint64_t TICK_MAX = std::numeric_limits<uint64_t>::max();
+} // namespace anonimus
+
+/* Scheduler */
+/* ************************************************************************** */
+
+const std::size_t Scheduler::LEVEL_BITS;
+const std::size_t Scheduler::SLOTS;
+const std::size_t Scheduler::LEVELS;
+
+Scheduler::Scheduler()
+    : m_wheel(),
+      m_timers_count(0),
+      m_current(0),
+      m_wake_tick(0),
+      m_epoch(std::chrono::steady_clock::now()),
+      m_mutex(),
+      m_cond(),
+      m_run(true),
+      m_thread()
+{
+    m_thread = std::thread(&Scheduler::Run, this);
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_run = false;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
 
-void TimerExpHandler(int sig, siginfo_t *si, void *uc)
+Scheduler::Handle Scheduler::Add(std::shared_ptr<Task> task, duration_t delay)
 {
-    auto scheduled_task = reinterpret_cast<scheduled_task_t*>(si->si_value.sival_ptr);
+    return (Add(task, std::chrono::steady_clock::now() + delay));
+}
 
-    auto task = scheduled_task->second;
+Scheduler::Handle Scheduler::Add(std::shared_ptr<Task> task, timepoint_t deadline)
+{
+    using namespace std::chrono;
 
-    if (-1 == timer_delete(scheduled_task->first))
+    nanoseconds since_epoch = std::max(duration_cast<nanoseconds>(deadline - m_epoch),
+                                       nanoseconds::zero());
+
+    // round up, a task never runs before its deadline
+    tick_t expiry = (since_epoch + tick_duration_t(1) - nanoseconds(1)) / tick_duration_t(1);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (0 == m_timers_count)
     {
-        std::cerr << "TimerExpHandler: " << std::strerror(errno) << std::endl;
+        // the wheel stood still while empty, it picks up from now rather than
+        // stepping through all the ticks since
+        m_current = std::max(m_current, NowTick());
     }
-    
-    delete scheduled_task;
 
-    task->operator()();
+    std::shared_ptr<Link> link(new Link());
+
+    slot_t added;
+    added.push_back(Timer({task, expiry, link}));
+    Place(added, added.begin());
+    ++m_timers_count;
+
+    if (expiry < m_wake_tick)
+    {
+        m_cond.notify_one();
+    }
 
-    (void) sig;
-    (void) uc;
+    return (Handle(this, link));
 }
 
-timespec TimepointToTimespec(Scheduler::timepoint_t tp)
+Scheduler::tick_t Scheduler::NowTick() const
 {
     using namespace std::chrono;
-    using nsec = std::chrono::nanoseconds;
-    using sec = std::chrono::seconds;
-
-    auto secs = time_point_cast<sec>(tp);
-    auto ns = time_point_cast<nsec>(tp) - time_point_cast<nsec>(secs);
 
-    return (timespec{secs.time_since_epoch().count(), ns.count()});
+    return (duration_cast<tick_duration_t>(steady_clock::now() - m_epoch).count());
 }
 
-void InitSegevent(struct sigevent *sev, scheduled_task_t *scheduled_task)
+void Scheduler::Place(slot_t &from, slot_t::iterator timer)
 {
-    std::memset(sev, 0, sizeof(struct sigevent));
-    sev->sigev_notify = SIGEV_SIGNAL;
-    sev->sigev_signo = SIGRTMIN;
+    tick_t expiry = std::max(timer->m_expiry, m_current);
+    tick_t delta = expiry - m_current;
+    std::size_t level = 0;
 
-    sev->sigev_value.sival_ptr = scheduled_task;
+    while (LEVELS - 1 > level && (tick_t(1) << (LEVEL_BITS * (level + 1))) <= delta)
+    {
+        ++level;
+    }
+
+    tick_t wheel_span = tick_t(1) << (LEVEL_BITS * LEVELS);
+    if (wheel_span <= delta)
+    {
+        // out of the wheel's reach, it gets placed again once the top level turns
+        expiry = m_current + wheel_span - 1;
+    }
+
+    slot_t &slot = m_wheel[level][(expiry >> (LEVEL_BITS * level)) & (SLOTS - 1)];
+    slot.splice(slot.end(), from, timer);
+
+    timer->m_link->m_slot = &slot;
+    timer->m_link->m_pos = timer;
 }
 
-void InitItimerspec(struct itimerspec *its, Scheduler::timepoint_t &deadline)
+void Scheduler::Cascade(tick_t tick)
 {
-    std::memset(its, 0, sizeof(struct itimerspec));
-    its->it_value = TimepointToTimespec(deadline);
+    for (std::size_t level = 1; level < LEVELS; ++level)
+    {
+        tick_t level_mask = (tick_t(1) << (LEVEL_BITS * level)) - 1;
+        if (0 != (tick & level_mask))
+        {
+            break;
+        }
+
+        slot_t cascaded;
+        cascaded.swap(m_wheel[level][(tick >> (LEVEL_BITS * level)) & (SLOTS - 1)]);
+
+        while (!cascaded.empty())
+        {
+            Place(cascaded, cascaded.begin());
+        }
+    }
 }
 
-void SetupSigHandler()
+Scheduler::tick_t Scheduler::NextWakeTick() const
 {
-    struct sigaction sa;
-    sa.sa_flags = SA_SIGINFO | SA_RESTART;
-    sa.sa_sigaction = TimerExpHandler;
-    sigemptyset(&sa.sa_mask);
+    tick_t wake = TICK_MAX;
+    std::size_t lowest_count = 0;
 
-    if (0 != sigaction(SIGRTMIN, &sa, nullptr))
+    for (std::size_t i = SLOTS; 0 < i; --i)
     {
-        throw std::runtime_error("SetupSigHandler failed");
+        const slot_t &slot = m_wheel[0][(m_current + i - 1) & (SLOTS - 1)];
+        if (!slot.empty())
+        {
+            wake = m_current + i - 1;
+            lowest_count += slot.size();
+        }
     }
-}
-} // namespace anonimus
 
-/* Scheduler */
-/* ************************************************************************** */
+    // higher levels are cascaded whenever the lowest one completes a turn
+    if (lowest_count < m_timers_count)
+    {
+        wake = std::min(wake, (m_current + SLOTS - 1) & ~tick_t(SLOTS - 1));
+    }
 
-Scheduler::Scheduler()
-{
-    SetupSigHandler();
+    return (wake);
 }
 
-Scheduler::~Scheduler()
-{}
-
-void Scheduler::Add(std::shared_ptr<Task> task, timepoint_t deadline)
+void Scheduler::Run()
 {
-    auto scheduled_task = new scheduled_task_t({nullptr, task});
-
-    struct sigevent sev;
-    InitSegevent(&sev, scheduled_task);
+    std::unique_lock<std::mutex> lock(m_mutex);
 
-    if (0 != timer_create(CLOCK_REALTIME, &sev, &scheduled_task->first))
+    while (m_run)
     {
-        throw std::runtime_error(std::strerror(errno));
+        tick_t now = NowTick();
+
+        if (0 == m_timers_count)
+        {
+            m_current = std::max(m_current, now);
+            m_wake_tick = TICK_MAX;
+            m_cond.wait(lock);
+            m_wake_tick = 0;
+
+            if (0 == m_timers_count)
+            {
+                m_current = std::max(m_current, NowTick());
+            }
+            continue;
+        }
+
+        tick_t wake = NextWakeTick();
+
+        if (now < wake)
+        {
+            m_wake_tick = wake;
+            m_cond.wait_until(lock, m_epoch + tick_duration_t(wake));
+            m_wake_tick = 0;
+            continue;
+        }
+
+        m_current = wake;
+        Cascade(m_current);
+
+        slot_t due;
+        due.swap(m_wheel[0][m_current & (SLOTS - 1)]);
+        m_timers_count -= due.size();
+        ++m_current;
+
+        for (auto &timer : due)
+        {
+            timer.m_link->m_slot = nullptr;
+        }
+
+        lock.unlock();
+
+        for (auto &timer : due)
+        {
+            try
+            {
+                (*timer.m_task)();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Scheduler task: " << e.what() << std::endl;
+            }
+        }
+        due.clear();
+
+        lock.lock();
     }
-    
-    struct itimerspec its;
-    InitItimerspec(&its, deadline);
+}
+
+bool Scheduler::Cancel(const std::weak_ptr<Link> &weak_link)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
 
-    if (0 != timer_settime(scheduled_task->first, TIMER_ABSTIME, &its, nullptr))
+    std::shared_ptr<Link> link = weak_link.lock();
+    if (!link || !link->m_slot)
     {
-        throw std::runtime_error(std::strerror(errno));
+        return (false);
     }
 
+    link->m_slot->erase(link->m_pos);
+    link->m_slot = nullptr;
+    --m_timers_count;
+
+    return (true);
 }
 
 Scheduler::Task::~Task()
-{}
\ No newline at end of file
+{}
+
+/* Handle */
+/* ************************************************************************** */
+
+Scheduler::Handle::Handle()
+    : m_scheduler(nullptr), m_link()
+{}
+
+Scheduler::Handle::Handle(Scheduler *scheduler, const std::shared_ptr<Link> &link)
+    : m_scheduler(scheduler), m_link(link)
+{}
+
+bool Scheduler::Handle::Cancel()
+{
+    if (!m_scheduler)
+    {
+        return (false);
+    }
+
+    return (m_scheduler->Cancel(m_link));
+}
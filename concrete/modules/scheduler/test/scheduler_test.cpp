@@ -8,6 +8,8 @@
 * 
 *******************************************************************************/
 
+#include <unistd.h> // sleep, usleep
+
 #include "testing.hpp" // testing::Testscmp, testing::UnitTest
 
 #include "handleton.hpp" // nsrd::Handleton
@@ -19,12 +21,16 @@ using namespace nsrd::testing;
 namespace
 {
 void TestGeneral();
+void TestCancel();
+void TestAfterIdle();
 } // namespace
 
 int main()
 {
     Testscmp cmp;
     cmp.AddTest(UnitTest("General", TestGeneral));
+    cmp.AddTest(UnitTest("Cancel", TestCancel));
+    cmp.AddTest(UnitTest("After idle", TestAfterIdle));
     cmp.Run();
 
     return (0);
@@ -54,7 +60,7 @@ void SleepFor(std::size_t secs)
 
 void TestGeneral()
 {
-    using sclock = std::chrono::system_clock;
+    using sclock = std::chrono::steady_clock;
     using secs = std::chrono::seconds;
 
     Scheduler *scheduler = Handleton<Scheduler>::GetInstance();
@@ -86,5 +92,57 @@ void TestGeneral()
     SleepFor(2);
 
     TH_ASSERT(6 == data);
+
+    data = 0;
+
+    scheduler->Add(task1, std::chrono::milliseconds(500));
+    scheduler->Add(task2, secs(1));
+
+    SleepFor(2);
+
+    TH_ASSERT(3 == data);
+}
+
+void TestCancel()
+{
+    using sclock = std::chrono::steady_clock;
+    using secs = std::chrono::seconds;
+
+    Scheduler *scheduler = Handleton<Scheduler>::GetInstance();
+
+    int data = 0;
+
+    std::shared_ptr<Scheduler::Task> task1(new TestTask(data, 1));
+    std::shared_ptr<Scheduler::Task> task2(new TestTask(data, 2));
+
+    Scheduler::Handle handle1 = scheduler->Add(task1, sclock::now() + secs(1));
+    Scheduler::Handle handle2 = scheduler->Add(task2, sclock::now() + secs(1));
+
+    TH_ASSERT(true == handle1.Cancel());
+    TH_ASSERT(false == handle1.Cancel());
+    TH_ASSERT(1 == task1.use_count());
+
+    SleepFor(2);
+
+    TH_ASSERT(2 == data);
+    TH_ASSERT(false == handle2.Cancel());
+    TH_ASSERT(false == Scheduler::Handle().Cancel());
+}
+
+void TestAfterIdle()
+{
+    Scheduler *scheduler = Handleton<Scheduler>::GetInstance();
+
+    int data = 0;
+    std::shared_ptr<Scheduler::Task> task(new TestTask(data, 1));
+
+    // the wheel stands still meanwhile, the timer still fires on time
+    SleepFor(3);
+
+    scheduler->Add(task, std::chrono::milliseconds(100));
+    usleep(50000);
+    TH_ASSERT(0 == data);
+    usleep(200000);
+    TH_ASSERT(1 == data);
 }
-} // namespace
\ No newline at end of file
+} // namespace
@@ -0,0 +1,91 @@
+/*******************************************************************************
+*
+* FILENAME : nbd_flush_command.cpp
+* 
+* AUTHOR : Nick Shenderov
+*
+* DATE : 02.12.2023
+* 
+*******************************************************************************/
+
+
+#define NOT_HANDLETON
+
+#include <iostream>
+
+#include "handleton.hpp"
+#include "plugin_tools.hpp"
+
+#include "minion_manager.hpp"
+#include "raid_manager.hpp"
+#include "nbd_params.hpp"
+#include "nbd_comm_proxy.hpp"
+#include "nbd_communicator.hpp"
+
+void PluginLoad() __attribute__((constructor));
+void PluginUnload() __attribute__((destructor));
+
+namespace
+{
+class NBDFlushCommand: public nsrd::ICommand
+{
+public:
+    NBDFlushCommand(nsrd::ICommandParams *params);
+    ~NBDFlushCommand();
+
+    void operator()();
+
+private:
+    nsrd::NBDParams *m_params;
+};
+
+NBDFlushCommand::NBDFlushCommand(nsrd::ICommandParams *params)
+    : m_params(dynamic_cast<nsrd::NBDParams *>(params))
+{}
+
+NBDFlushCommand::~NBDFlushCommand()
+{
+    delete m_params;
+    m_params = nullptr;
+}
+
+nsrd::ICommand *NBDFlushCommandBuilder(nsrd::ICommandParams *params)
+{
+    return (new NBDFlushCommand(params));
+}
+
+void NBDFlushCommand::operator()()
+{
+    #ifndef NDEBUG
+    std::cout << "[NBD_FLUSH_COMMAND] Called command's operator()" << std::endl;
+    #endif
+
+    nsrd::RaidManager::flush_callback_t flush_handler = [](std::size_t minion_idx)->bool
+    {
+        nsrd::MinionManager *manager = nsrd::Handleton<nsrd::MinionManager>::GetInstance();
+        return (manager->PerformCommand(minion_idx, {0, 0, nullptr}, nsrd::MinionManager::CommandType::FLUSH_CMD));
+    };
+
+    nsrd::RaidManager *raid_manager = nsrd::Handleton<nsrd::RaidManager>::GetInstance();
+    bool status = raid_manager->Flush(&flush_handler);
+
+    nsrd::NBDCommProxy *nbd = nsrd::Handleton<nsrd::NBDCommProxy>::GetInstance();
+    nbd->Reply(status ? nsrd::NBDCommunicator::StatusType::SUCCESS
+                      : nsrd::NBDCommunicator::StatusType::IO_ERROR, m_params->m_event_id);
+}
+
+} // anonimus namespace
+
+void PluginLoad()
+{
+    std::cout << "[NBD_FLUSH_COMMAND] Plugin load" << std::endl;
+
+    nsrd::RegisterBuilder(NBDFlushCommandBuilder, nsrd::NBDCommunicator::EventType::FLUSH);
+}
+
+void PluginUnload()
+{
+    std::cout << "[NBD_FLUSH_COMMAND] Plugin unload" << std::endl;
+
+    nsrd::RemoveBuilder(nsrd::NBDCommunicator::EventType::FLUSH);
+}
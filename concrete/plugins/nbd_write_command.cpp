@@ -80,8 +80,24 @@ void NBDWriteCommand::operator()()
     nsrd::RaidManager *raid_manager = nsrd::Handleton<nsrd::RaidManager>::GetInstance();
     raid_manager->Write({m_params->m_len, m_params->m_offset, m_params->m_data}, &write_handler);
 
+    nsrd::NBDCommunicator::StatusType status = nsrd::NBDCommunicator::StatusType::SUCCESS;
+
+    if (m_params->m_fua)
+    {
+        nsrd::RaidManager::flush_callback_t flush_handler = [](std::size_t minion_idx)->bool
+        {
+            nsrd::MinionManager *manager = nsrd::Handleton<nsrd::MinionManager>::GetInstance();
+            return (manager->PerformCommand(minion_idx, {0, 0, nullptr}, nsrd::MinionManager::CommandType::FLUSH_CMD));
+        };
+
+        if (!raid_manager->Flush(&flush_handler))
+        {
+            status = nsrd::NBDCommunicator::StatusType::IO_ERROR;
+        }
+    }
+
     nsrd::NBDCommProxy *nbd = nsrd::Handleton<nsrd::NBDCommProxy>::GetInstance();
-    nbd->Reply(nsrd::NBDCommunicator::StatusType::SUCCESS, m_params->m_event_id);
+    nbd->Reply(status, m_params->m_event_id);
 
     delete m_params->m_data;
     m_params->m_data = nullptr;
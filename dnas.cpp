@@ -13,7 +13,12 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <tuple>
+#include <algorithm>
+#include <cerrno>
 #include <arpa/inet.h>
+#include <fcntl.h>
 
 #include "framework.hpp"
 #include "handleton.hpp"
@@ -37,9 +42,44 @@ enum NAS_ARG {DEV_PATH = 1, DEV_SIZE, PLUG_PATH, MINION_ADDRS_PATH, NAS_ARGS};
 void ValidateArguments(int argc, char const *argv[]);
 void ClosingDriver(Framework *fr);
 std::size_t ComputeDevSize(std::size_t mb);
-int ReadData(int fd, char *buf, std::size_t count);
-std::pair<builder_id_t, ICommandParams * > HandleSocketRead(int fd);
 void GetMinions(char const *argv[]);
+
+// Parses the requests coming from the NBD communicator as their bytes
+// arrive, reading only what is there, and hands out each one when complete.
+// A request is keyed by every RAID stripe it touches, so the requests
+// overlapping in a stripe run in the order they came. Once the communicator
+// closes the socket, or reading it fails, the reader stops the framework
+// listening to it.
+class NBDRequestReader
+{
+public:
+    typedef std::tuple<builder_id_t, ICommandParams *, Framework::order_key_t, std::size_t>
+        command_t;
+
+    explicit NBDRequestReader(int fd, Framework *framework, std::size_t stripe_size);
+    command_t operator()(int fd);
+
+private:
+    enum State {HEADER, PAYLOAD};
+
+    struct Request
+    {
+        Request();
+        ~Request();
+
+        State m_state;
+        NBDCommunicator::Event m_event;
+        std::size_t m_received;
+        NBDParams *m_params;
+    };
+
+    std::shared_ptr<Request> m_request; // shared by the copies the framework makes
+    Framework *m_framework;
+    std::size_t m_stripe_size;
+
+    bool Receive(int fd, char *buf, std::size_t count);
+    command_t Complete();
+};
 } // namespace anonimus
 
 
@@ -62,7 +102,9 @@ int main(int argc, char const *argv[])
 
     Framework fr(argv[PLUG_PATH]);
 
-    fr.AddSocketHandler(nbd->GetNBDFileDescriptor(), SocketEventType::READ, HandleSocketRead);
+    fr.AddOrderedSocketHandler(nbd->GetNBDFileDescriptor(), SocketEventType::READ,
+                               NBDRequestReader(nbd->GetNBDFileDescriptor(), &fr,
+                                                raid_manager->GetStripeSize()));
 
     std::cout
     << YELLOW "Framework intialized\n"
@@ -139,44 +181,119 @@ inline std::size_t ComputeDevSize(std::size_t mb)
     return (mb * (1024 * 1024));
 }
 
-int ReadData(int fd, char *buf, std::size_t count)
-{
-  int bytes_read = 0;
+NBDRequestReader::Request::Request()
+    : m_state(HEADER), m_event(), m_received(0), m_params(nullptr)
+{}
 
-  while (0 < count && 0 < (bytes_read = read(fd, buf, count)))
-  {
-    buf += bytes_read;
-    count -= bytes_read;
-  }
+NBDRequestReader::Request::~Request()
+{
+    if (m_params)
+    {
+        operator delete(m_params->m_data);
+        delete m_params;
+    }
+}
 
-  return (bytes_read);
+NBDRequestReader::NBDRequestReader(int fd, Framework *framework, std::size_t stripe_size)
+    : m_request(new Request()), m_framework(framework), m_stripe_size(stripe_size)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (-1 == flags || -1 == fcntl(fd, F_SETFL, flags | O_NONBLOCK))
+    {
+        std::cerr << "[NBD_REQUEST_READER] Couldn't make the socket non-blocking" << std::endl;
+    }
 }
 
-std::pair<builder_id_t, ICommandParams * > HandleSocketRead(int fd)
+NBDRequestReader::command_t NBDRequestReader::operator()(int fd)
 {
     #ifndef NDEBUG
     std::cout << "[HANDLE_SOCKET_READ] Processing socket" << std::endl;
     #endif
 
-    NBDCommunicator::Event event;
+    Request &request = *m_request;
+
+    if (HEADER == request.m_state)
+    {
+        if (!Receive(fd, reinterpret_cast<char *>(&request.m_event), sizeof(NBDCommunicator::Event)))
+        {
+            return (command_t(0, nullptr, 0, 0));
+        }
+
+        NBDParams *params = new NBDParams();
+        params->m_len = request.m_event.m_length;
+        params->m_offset = request.m_event.m_offset;
+        params->m_fua = request.m_event.m_fua;
+        std::memcpy(params->m_event_id, request.m_event.m_event_id, sizeof(params->m_event_id));
+
+        request.m_params = params;
+
+        if (NBDCommunicator::WRITE != request.m_event.m_type || 0 == params->m_len)
+        {
+            return (Complete());
+        }
 
-    if (-1 == read(fd, &event, sizeof(NBDCommunicator::Event)))
+        params->m_data = static_cast<char *>(operator new(params->m_len));
+        request.m_state = PAYLOAD;
+    }
+
+    if (!Receive(fd, request.m_params->m_data, request.m_params->m_len))
     {
-        std::cerr << "[HANDLE_SOCKET_READ] Error reading socket" << std::endl;
+        return (command_t(0, nullptr, 0, 0));
     }
 
-    NBDParams *params = new NBDParams();
-    params->m_len = event.m_length;
-    params->m_offset = event.m_offset;
-    std::memcpy(params->m_event_id, event.m_event_id, sizeof(sizeof(char) * 8));
+    return (Complete());
+}
 
-    if (NBDCommunicator::WRITE == event.m_type)
+// reads what is available, returns true once count bytes have been received
+bool NBDRequestReader::Receive(int fd, char *buf, std::size_t count)
+{
+    Request &request = *m_request;
+
+    while (request.m_received < count)
     {
-        params->m_data = static_cast<char *>(operator new(params->m_len));
-        ReadData(fd, params->m_data, params->m_len);
+        ssize_t bytes_read = read(fd, buf + request.m_received, count - request.m_received);
+        if (0 < bytes_read)
+        {
+            request.m_received += bytes_read;
+            continue;
+        }
+
+        if (-1 == bytes_read && EINTR == errno)
+        {
+            continue;
+        }
+
+        if (0 == bytes_read || (EAGAIN != errno && EWOULDBLOCK != errno))
+        {
+            // the socket stays readable for good, level-triggered it would
+            // wake the loop over and over
+            std::cerr << "[HANDLE_SOCKET_READ] Socket closed or failed, no longer reading it"
+                      << std::endl;
+            m_framework->RemoveSocketHandler(fd, SocketEventType::READ);
+        }
+
+        return (false);
     }
 
-    return (std::pair<builder_id_t, ICommandParams*>(event.m_type, params));
+    request.m_received = 0;
+
+    return (true);
+}
+
+NBDRequestReader::command_t NBDRequestReader::Complete()
+{
+    Request &request = *m_request;
+
+    NBDParams *params = request.m_params;
+    request.m_params = nullptr;
+    request.m_state = HEADER;
+
+    // a request of no length, a FLUSH, is keyed by the stripe of its offset
+    std::size_t first = params->m_offset / m_stripe_size;
+    std::size_t last = (params->m_offset + std::max<std::size_t>(params->m_len, 1) - 1) /
+                       m_stripe_size;
+
+    return (command_t(request.m_event.m_type, params, first, last - first + 1));
 }
 
 void GetMinions(char const *argv[])
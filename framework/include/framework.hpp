@@ -33,21 +33,46 @@
 
 #include <atomic> // std::atomic
 #include <functional> // std::function
+#include <vector> // std::vector
+#include <memory> // std::unique_ptr
+#include <map> // std::map
+#include <mutex> // std::mutex
+#include <tuple> // std::tuple
 
 #include "framework_factory.hpp" // concrete nsrd::Factory
 #include "logger.hpp" // nsrd::Logger
 #include "dir_monitor.hpp" // nsrd::DirMonitor
 #include "dll_loader.hpp" // nsrd::DirLoader
 #include "reactor.hpp" // nsrd::Reactor
+#include "thread_pool.hpp" // nsrd::ThreadPool
+#include "auto_scaler.hpp" // nsrd::AutoScaler
+#include "strands.hpp" // nsrd::Strands
+#include "placement.hpp" // nsrd::Placement
 
 namespace nsrd
 {
 class Framework
 {
 public:
+    // a null parameters object emits no command, so a handler may read a
+    // request across several events and return it once it is complete
     typedef std::function<std::pair<builder_id_t, ICommandParams * > (int fd)> socket_handler_t;
+    typedef Strands::key_t order_key_t;
+    // also returns the first of the command's ordering keys, e.g. the
+    // stripes a write goes to, and their number
+    typedef std::function<std::tuple<builder_id_t, ICommandParams *,
+                                     order_key_t, std::size_t> (int fd)>
+        ordered_socket_handler_t;
 
-    explicit Framework(const std::string &plugin_dir_path);
+    static const std::size_t ANY_LOOP = static_cast<std::size_t>(-1);
+    // an AutoScaler sizes each pool from a single thread up to this many per
+    // core of its loop, the commands mostly wait on the minions
+    static const std::size_t MAX_THREADS_PER_CORE = 8;
+
+    // each loop is a reactor with a pool of its own on a thread pinned to a
+    // core, the loops spread over the NUMA nodes and the pool's workers kept
+    // on the loop's node
+    explicit Framework(const std::string &plugin_dir_path, std::size_t loops_num = 1);
     ~Framework() noexcept;
 
     Framework(Framework &) = delete;
@@ -55,27 +80,41 @@ public:
     Framework &operator=(Framework &) = delete;
     Framework &operator=(Framework &&) = delete;
 
-    void Run();  // blocking function
+    void Run();  // blocking function, a single loop is driven on the calling thread
     void Stop(); // needs to be called asynchroniously
 
-    void AddSocketHandler(int fd, SocketEventType type, const socket_handler_t &handler);
+    // chains may be added and removed from any thread while running; the
+    // commands of an endpoint run on the pool of its loop, by default the
+    // one its fd hashes to
+    void AddSocketHandler(int fd, SocketEventType type, const socket_handler_t &handler,
+                          std::size_t loop = ANY_LOOP);
+    // the commands sharing a key run one at a time in the order they were
+    // emitted, those with none in common in parallel; keys are shared by the
+    // ordered chains of a loop, not across loops
+    void AddOrderedSocketHandler(int fd, SocketEventType type,
+                                 const ordered_socket_handler_t &handler,
+                                 std::size_t loop = ANY_LOOP);
+    // once it returns the endpoint is no longer listened to, commands
+    // already handed over may still run
     void RemoveSocketHandler(int fd, SocketEventType type);
 
 private:
-    enum PIPE_PAIR {READ_END = 0, WRITE_END, PIPE_PAIR};
-
-    Reactor m_fd_monitor;
-    ThreadPool m_th_pool;
+    Placement m_loop_placement;
+    std::vector<std::unique_ptr<Reactor> > m_fd_monitors;
+    std::vector<std::unique_ptr<ThreadPool> > m_th_pools; // one per loop
+    std::vector<std::unique_ptr<AutoScaler> > m_scalers; // one per pool
+    std::vector<std::unique_ptr<Strands> > m_strands; // one per pool
+    std::map<std::pair<int, SocketEventType>, std::size_t> m_handler_loops;
+    std::mutex m_handler_loops_mutex;
     framework_factory_t *m_commands_factory;
     DirMonitor m_plugins_dir_monitor;
     DllLoader m_plugins_loader;
     Logger *m_logger;
     std::atomic<bool> m_run;
-    int m_stop_fd_monitor_pipe[PIPE_PAIR];
-
-    void StopFdMonitorHandler();
-    void SetUpDefHandlers();
 
+    void RunLoop(std::size_t loop);
+    // the loop the endpoint goes to
+    std::size_t RegisterHandler(int fd, SocketEventType type, std::size_t loop);
 };
 } // namespace rd
 
@@ -6,6 +6,11 @@
 *
 * DATE : 21.09.2023
 * 
+* Messages are handed to a single writer thread through a lock-free ring, so
+* logging threads don't queue up behind each other on a lock. While the
+* writer is QUEUE_CAPACITY messages behind, logging waits for room. Messages
+* still queued when the logger is destroyed are written out first.
+* 
 *******************************************************************************/
 
 #ifndef NSRD_LOGGER_HPP
@@ -13,9 +18,13 @@
 
 #include <string> // std::string
 #include <iomanip> // std::put_time
+#include <memory> // std::shared_ptr
+#include <thread> // std::thread
 
 #include "handleton.hpp" // nsrd::Handleton
-#include "thread_pool.hpp" // nsrd::ThreadPool
+#include "task.hpp" // nsrd::Task
+#include "waitable_queue.hpp" // nsrd::WaitableQueue
+#include "mpmc_ring.hpp" // nsrd::MPMCRing
 
 namespace nsrd
 {
@@ -35,10 +44,19 @@ public:
     Logger &operator=(Logger&&) = delete;
 
 private:
+    class LogTask;
+    static const std::size_t QUEUE_CAPACITY = 4096;
+    typedef std::shared_ptr<LogTask> log_task_t;
+
     explicit Logger();
+    ~Logger() noexcept;
     friend class Handleton<Logger>;
     static std::string s_pathname;
-    ThreadPool m_pool;
+    WaitableQueue<log_task_t, MPMCRing<log_task_t, QUEUE_CAPACITY> > m_queue;
+    std::thread m_writer;
+
+    void Log(const std::string &type, const std::string &message);
+    void Write(); // the writer thread, an empty task stops it
 
     class LogTask : public Task
     {
@@ -19,6 +19,8 @@ using namespace nsrd;
 /* Logger */
 /* ************************************************************************** */
 
+const std::size_t Logger::QUEUE_CAPACITY;
+
 std::string Logger::s_pathname("./framework.log");
 
 void Logger::SetPath(const std::string &new_path) noexcept
@@ -27,31 +29,54 @@ void Logger::SetPath(const std::string &new_path) noexcept
 }
 
 Logger::Logger()
-    : m_pool(1UL)
+    : m_queue(), m_writer(&Logger::Write, this)
 {}
 
+Logger::~Logger() noexcept
+{
+    m_queue.Push(log_task_t());
+    m_writer.join();
+}
+
 void Logger::Info(const std::string &message)
 {
-    std::shared_ptr<Task> task(new LogTask("info", message));
-    m_pool.Add(task, ThreadPool::HIGH);
+    Log("info", message);
 }
 
 void Logger::Warn(const std::string &message)
 {
-    std::shared_ptr<Task> task(new LogTask("warn", message));
-    m_pool.Add(task, ThreadPool::HIGH);
+    Log("warn", message);
 }
 
 void Logger::Error(const std::string &message)
 {
-    std::shared_ptr<Task> task(new LogTask("error", message));
-    m_pool.Add(task, ThreadPool::HIGH);
+    Log("error", message);
 }
 
 void Logger::Debug(const std::string &message)
 {
-    std::shared_ptr<Task> task(new LogTask("debug", message));
-    m_pool.Add(task, ThreadPool::HIGH);
+    Log("debug", message);
+}
+
+void Logger::Log(const std::string &type, const std::string &message)
+{
+    m_queue.Push(log_task_t(new LogTask(type, message)));
+}
+
+void Logger::Write()
+{
+    log_task_t task;
+
+    while (true)
+    {
+        m_queue.Pop(task);
+        if (!task)
+        {
+            break;
+        }
+
+        (*task)();
+    }
 }
 
 /* LogTask */
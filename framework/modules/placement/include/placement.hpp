@@ -0,0 +1,251 @@
+/*******************************************************************************
+*
+* FILENAME : placement.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+* Where a group of threads runs. The i-th thread of the group calls Apply(i)
+* as it starts, which pins it and makes the memory it allocates come from
+* its NUMA node first, so the buffers it works on stay in its caches and on
+* its socket.
+*
+* With PER_CPU each thread is pinned to a CPU of its own, with PER_NODE to
+* all the CPUs of a node; either way the threads go round-robin over the
+* nodes, so the load is spread evenly between the sockets. The CPUs are the
+* ones given, or the ones the process may run on. UNPINNED leaves the threads
+* to the scheduler.
+*
+* The nodes are read from sysfs; without it all the CPUs are taken as one
+* node. The memory policy is set only if the machine has several nodes, so
+* a placement over a single node of such a machine still sets it.
+*
+*******************************************************************************/
+
+#ifndef NSRD_PLACEMENT_HPP
+#define NSRD_PLACEMENT_HPP
+
+#include <cstddef> // std::size_t
+#include <vector> // std::vector
+#include <string> // std::string, std::to_string
+#include <fstream> // std::ifstream
+#include <sstream> // std::istringstream
+#include <algorithm> // std::find, std::sort
+#include <exception> // std::exception
+#include <pthread.h> // pthread_setaffinity_np, pthread_self
+#include <sched.h> // cpu_set_t, CPU_SET, sched_getaffinity
+#include <unistd.h> // syscall
+#include <sys/syscall.h> // SYS_set_mempolicy
+#include <linux/mempolicy.h> // MPOL_PREFERRED
+
+namespace nsrd
+{
+class Placement
+{
+public:
+    enum Policy { UNPINNED, PER_CPU, PER_NODE };
+
+    explicit Placement(Policy policy = UNPINNED, const std::vector<int> &cpus = std::vector<int>());
+
+    Policy GetPolicy() const;
+    std::size_t GetNodesNum() const;
+    // the node of the index-th thread, -1 if UNPINNED
+    int GetNode(std::size_t index) const;
+    // the CPUs of the index-th thread's node, empty if UNPINNED
+    std::vector<int> GetNodeCpus(std::size_t index) const;
+
+    // to be called by the index-th thread itself, false if it couldn't be
+    // pinned or its memory policy set
+    bool Apply(std::size_t index) const;
+
+private:
+    static const std::size_t MAX_NODES = 1024;
+
+    Policy m_policy;
+    bool m_is_numa;
+    std::vector<int> m_node_ids;
+    std::vector<std::vector<int> > m_nodes; // the CPUs used, by node
+
+    std::size_t NodeIdx(std::size_t index) const;
+    static std::vector<int> AllowedCpus();
+    // a list of ranges like sysfs gives, of CPUs or of nodes
+    static std::vector<int> ParseCpuList(const std::string &list);
+};
+
+inline Placement::Placement(Policy policy, const std::vector<int> &cpus)
+    : m_policy(policy), m_is_numa(false), m_node_ids(), m_nodes()
+{
+    if (UNPINNED == m_policy)
+    {
+        return;
+    }
+
+    std::vector<int> used;
+    for (int cpu : cpus.empty() ? AllowedCpus() : cpus)
+    {
+        if (0 <= cpu && CPU_SETSIZE > cpu)
+        {
+            used.push_back(cpu);
+        }
+    }
+
+    std::string list;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::getline(online, list);
+
+    // the node ids may have gaps
+    std::vector<int> nodes = ParseCpuList(list);
+    m_is_numa = 1 < nodes.size();
+
+    for (int node : nodes)
+    {
+        std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) +
+                              "/cpulist");
+        std::string node_list;
+        std::getline(cpulist, node_list);
+
+        std::vector<int> node_cpus;
+        for (int cpu : ParseCpuList(node_list))
+        {
+            if (used.end() != std::find(used.begin(), used.end(), cpu))
+            {
+                node_cpus.push_back(cpu);
+            }
+        }
+
+        if (!node_cpus.empty() && MAX_NODES > static_cast<std::size_t>(node))
+        {
+            m_node_ids.push_back(node);
+            m_nodes.push_back(node_cpus);
+        }
+    }
+
+    if (m_nodes.empty())
+    {
+        // no sysfs, or it doesn't know the given CPUs
+        std::sort(used.begin(), used.end());
+        m_node_ids.push_back(0);
+        m_nodes.push_back(used);
+    }
+}
+
+inline Placement::Policy Placement::GetPolicy() const
+{
+    return (m_policy);
+}
+
+inline std::size_t Placement::GetNodesNum() const
+{
+    return (m_nodes.size());
+}
+
+inline int Placement::GetNode(std::size_t index) const
+{
+    return (UNPINNED == m_policy ? -1 : m_node_ids[NodeIdx(index)]);
+}
+
+inline std::vector<int> Placement::GetNodeCpus(std::size_t index) const
+{
+    return (UNPINNED == m_policy ? std::vector<int>() : m_nodes[NodeIdx(index)]);
+}
+
+inline bool Placement::Apply(std::size_t index) const
+{
+    if (UNPINNED == m_policy)
+    {
+        return (true);
+    }
+
+    const std::vector<int> &node_cpus = m_nodes[NodeIdx(index)];
+    if (node_cpus.empty())
+    {
+        return (false); // the allowed CPUs couldn't be read
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (PER_CPU == m_policy)
+    {
+        // the index-th thread of the node, nodes taking turns
+        CPU_SET(node_cpus[(index / m_nodes.size()) % node_cpus.size()], &set);
+    }
+    else
+    {
+        for (int cpu : node_cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    bool is_applied = (0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set));
+
+    if (m_is_numa)
+    {
+        // preferred, not bound: a full node lends memory rather than failing
+        unsigned long mask[MAX_NODES / (sizeof(unsigned long) * 8)] = {0};
+        std::size_t bits = sizeof(unsigned long) * 8;
+        std::size_t node = static_cast<std::size_t>(m_node_ids[NodeIdx(index)]);
+        mask[node / bits] |= 1UL << (node % bits);
+
+        is_applied = is_applied && 0 == syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                                                sizeof(mask) * 8);
+    }
+
+    return (is_applied);
+}
+
+inline std::size_t Placement::NodeIdx(std::size_t index) const
+{
+    return (index % m_nodes.size());
+}
+
+inline std::vector<int> Placement::AllowedCpus()
+{
+    std::vector<int> cpus;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (0 == sched_getaffinity(0, sizeof(set), &set))
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    return (cpus);
+}
+
+inline std::vector<int> Placement::ParseCpuList(const std::string &list)
+{
+    // e.g. "0-3,8-11,16"
+    std::vector<int> cpus;
+    std::istringstream ranges(list);
+    std::string range;
+
+    while (std::getline(ranges, range, ','))
+    {
+        std::size_t dash = range.find('-');
+        try
+        {
+            int first = std::stoi(range.substr(0, dash));
+            int last = std::string::npos == dash ? first : std::stoi(range.substr(dash + 1));
+
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception &)
+        {} // an empty list, or garbage
+    }
+
+    return (cpus);
+}
+} // namespace nsrd
+
+#endif // NSRD_PLACEMENT_HPP
@@ -0,0 +1,132 @@
+/*******************************************************************************
+*
+* FILENAME : placement_test.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+*******************************************************************************/
+
+#include <vector> // std::vector
+#include <thread> // std::thread
+#include <algorithm> // std::find
+#include <pthread.h> // pthread_getaffinity_np
+#include <sched.h> // cpu_set_t, CPU_ISSET, sched_getaffinity
+
+#include "testing.hpp" // nsrd::testing::Testscmp, nsrd::testing::UnitTest
+#include "placement.hpp" // nsrd::Placement
+
+using namespace nsrd;
+using namespace nsrd::testing;
+
+namespace
+{
+void TestUnpinned();
+void TestPerCpu();
+void TestPerNode();
+} // namespace
+
+int main()
+{
+    Testscmp cmp;
+    cmp.AddTest(UnitTest("Unpinned", TestUnpinned));
+    cmp.AddTest(UnitTest("Per CPU", TestPerCpu));
+    cmp.AddTest(UnitTest("Per node", TestPerNode));
+    cmp.Run();
+
+    return (0);
+}
+
+namespace
+{
+std::vector<int> Affinity()
+{
+    std::vector<int> cpus;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return (cpus);
+}
+
+// the affinity the index-th thread gets from the placement
+std::vector<int> AffinityOf(const Placement &placement, std::size_t index, bool &is_applied)
+{
+    std::vector<int> cpus;
+    std::thread thread([&]()
+    {
+        is_applied = placement.Apply(index);
+        cpus = Affinity();
+    });
+    thread.join();
+
+    return (cpus);
+}
+
+void TestUnpinned()
+{
+    Placement placement;
+    bool is_applied = false;
+
+    TH_ASSERT(Placement::UNPINNED == placement.GetPolicy());
+    TH_ASSERT(-1 == placement.GetNode(0));
+    TH_ASSERT(true == placement.GetNodeCpus(0).empty());
+    TH_ASSERT(Affinity() == AffinityOf(placement, 3, is_applied));
+    TH_ASSERT(true == is_applied);
+}
+
+void TestPerCpu()
+{
+    std::vector<int> allowed = Affinity();
+    Placement placement(Placement::PER_CPU);
+    bool is_applied = false;
+
+    TH_ASSERT(1 <= placement.GetNodesNum());
+
+    std::size_t cpus_num = 0;
+    for (std::size_t node = 0; node < placement.GetNodesNum(); ++node)
+    {
+        cpus_num += placement.GetNodeCpus(node).size();
+    }
+    TH_ASSERT(allowed.size() == cpus_num);
+
+    // every thread on a CPU of its own node
+    for (std::size_t i = 0; i < allowed.size() * 2; ++i)
+    {
+        std::vector<int> cpus = AffinityOf(placement, i, is_applied);
+        std::vector<int> node_cpus = placement.GetNodeCpus(i);
+
+        TH_ASSERT(true == is_applied);
+        TH_ASSERT(1 == cpus.size());
+        TH_ASSERT(node_cpus.end() != std::find(node_cpus.begin(), node_cpus.end(), cpus[0]));
+    }
+
+    // only the CPUs given
+    Placement single(Placement::PER_CPU, std::vector<int>(1, allowed.back()));
+    TH_ASSERT(1 == single.GetNodesNum());
+    TH_ASSERT(std::vector<int>(1, allowed.back()) == AffinityOf(single, 7, is_applied));
+    TH_ASSERT(true == is_applied);
+}
+
+void TestPerNode()
+{
+    Placement placement(Placement::PER_NODE);
+    bool is_applied = false;
+
+    for (std::size_t i = 0; i < placement.GetNodesNum() * 2; ++i)
+    {
+        TH_ASSERT(placement.GetNodeCpus(i) == AffinityOf(placement, i, is_applied));
+        TH_ASSERT(true == is_applied);
+        TH_ASSERT(placement.GetNode(i) == placement.GetNode(i + placement.GetNodesNum()));
+    }
+}
+} // namespace
@@ -42,7 +42,7 @@ public:
 private:
     using ifystruct = struct inotify_event;
     using handler_func = std::function<void(const ifystruct *, DirEvent &)>;
-    using time_point = std::chrono::time_point<std::chrono::system_clock>;
+    using time_point = std::chrono::time_point<std::chrono::steady_clock>;
 
     void Watch();
     void HandleAdded(const ifystruct *, DirEvent &);
@@ -129,7 +129,7 @@ void DirMonitor::HandleAdded(const ifystruct *event, DirEvent &events_to_broadca
     std::cout << "[added] " << event->name << std::endl;
     #endif
 
-    m_cooldowns[event->name] = std::chrono::system_clock::now() + std::chrono::seconds(2);
+    m_cooldowns[event->name] = std::chrono::steady_clock::now() + std::chrono::seconds(2);
     events_to_broadcast.push_back({m_dir_path + event->name, ADDED});
 }
 
@@ -141,7 +141,7 @@ void DirMonitor::HandleRemoved(const ifystruct *event, DirEvent &events_to_broad
     }
 
     auto it = m_cooldowns.find(event->name);
-    if (it != m_cooldowns.end() && std::chrono::system_clock::now() >= m_cooldowns[event->name])
+    if (it != m_cooldowns.end() && std::chrono::steady_clock::now() >= m_cooldowns[event->name])
     {
         m_cooldowns.erase(event->name);
     }
@@ -161,7 +161,7 @@ void DirMonitor::HandleUpdated(const ifystruct *event, DirEvent &events_to_broad
     }
     
     auto it = m_cooldowns.find(event->name);
-    if (it != m_cooldowns.end() && std::chrono::system_clock::now() < m_cooldowns[event->name])
+    if (it != m_cooldowns.end() && std::chrono::steady_clock::now() < m_cooldowns[event->name])
     {
         return;
     }
@@ -0,0 +1,172 @@
+/*******************************************************************************
+*
+* FILENAME : bucket_queue.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 10.09.2023
+*
+* A priority queue for a small, fixed number of priority levels: a FIFO per
+* level and a bitmap of the levels that aren't empty. push_back appends to
+* its level's FIFO and sets the level's bit, front looks at the highest set
+* bit, so both are O(1) and elements of equal priority come out in the order
+* they were pushed.
+*
+* With a starvation limit a level that isn't empty counts the elements
+* popped past it from the levels above; once the count reaches the limit its
+* front comes out next, whatever is above. Levels under a steady load from
+* above are still served then, about once per limit pops, and the levels
+* keep their order between themselves. A limit of 0 leaves the order strict.
+*
+* It has the interface of PriorityQueue, so it may stand in for it as the
+* container of a WaitableQueue.
+*
+*******************************************************************************/
+
+#ifndef NSRD_BUCKET_QUEUE_HPP
+#define NSRD_BUCKET_QUEUE_HPP
+
+#include <cstddef> // std::size_t
+#include <deque> // std::deque
+#include <utility> // std::move, std::forward
+
+namespace nsrd
+{
+// LEVEL_OF()(const T &) gives an element's level, from 0 to LEVELS - 1; the
+// highest level comes out first
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+class BucketQueue
+{
+public:
+    explicit BucketQueue(std::size_t starvation_limit = 0);
+    // ~BucketQueue() = default;
+
+    void push_back(const T &data);
+    void push_back(T &&data);
+    template <typename... ARGS>
+    void emplace_back(ARGS&&... args);
+    void pop_front();
+    const T &front() const;
+    // only pop_front may follow moving the front out
+    T &front();
+    bool empty() const;
+
+private:
+    typedef unsigned long long bitmap_t;
+
+    static_assert(0 < LEVELS && LEVELS <= sizeof(bitmap_t) * 8,
+                  "BucketQueue: LEVELS must fit in the bitmap");
+
+    std::deque<T> m_buckets[LEVELS];
+    bitmap_t m_nonempty; // bit i is set while m_buckets[i] holds elements
+    std::size_t m_starvation_limit;
+    std::size_t m_passes[LEVELS]; // popped past a non-empty level since it was served
+
+    // the level to be popped from next, the queue mustn't be empty
+    std::size_t Top() const;
+    static std::size_t Highest(bitmap_t bitmap);
+};
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+BucketQueue<T, LEVELS, LEVEL_OF>::BucketQueue(std::size_t starvation_limit)
+    : m_buckets(), m_nonempty(0), m_starvation_limit(starvation_limit), m_passes()
+{}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+void BucketQueue<T, LEVELS, LEVEL_OF>::push_back(const T &data)
+{
+    std::size_t level = LEVEL_OF()(data);
+
+    m_buckets[level].push_back(data);
+    m_nonempty |= bitmap_t(1) << level;
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+void BucketQueue<T, LEVELS, LEVEL_OF>::push_back(T &&data)
+{
+    std::size_t level = LEVEL_OF()(data);
+
+    m_buckets[level].push_back(std::move(data));
+    m_nonempty |= bitmap_t(1) << level;
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+template <typename... ARGS>
+void BucketQueue<T, LEVELS, LEVEL_OF>::emplace_back(ARGS&&... args)
+{
+    // the level is known only once the element exists
+    push_back(T(std::forward<ARGS>(args)...));
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+void BucketQueue<T, LEVELS, LEVEL_OF>::pop_front()
+{
+    std::size_t level = Top();
+
+    m_buckets[level].pop_front();
+    if (m_buckets[level].empty())
+    {
+        m_nonempty &= ~(bitmap_t(1) << level);
+    }
+
+    if (0 != m_starvation_limit)
+    {
+        m_passes[level] = 0;
+
+        bitmap_t below = m_nonempty & ((bitmap_t(1) << level) - 1);
+        for (; 0 != below; below &= below - 1)
+        {
+            ++m_passes[__builtin_ctzll(below)];
+        }
+    }
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+const T &BucketQueue<T, LEVELS, LEVEL_OF>::front() const
+{
+    return (m_buckets[Top()].front());
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+T &BucketQueue<T, LEVELS, LEVEL_OF>::front()
+{
+    return (m_buckets[Top()].front());
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+bool BucketQueue<T, LEVELS, LEVEL_OF>::empty() const
+{
+    return (0 == m_nonempty);
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+std::size_t BucketQueue<T, LEVELS, LEVEL_OF>::Top() const
+{
+    std::size_t top = Highest(m_nonempty);
+
+    if (0 != m_starvation_limit)
+    {
+        // the highest of the starved levels below, if any
+        bitmap_t below = m_nonempty & ((bitmap_t(1) << top) - 1);
+        while (0 != below)
+        {
+            std::size_t level = Highest(below);
+            if (m_starvation_limit <= m_passes[level])
+            {
+                return (level);
+            }
+            below &= ~(bitmap_t(1) << level);
+        }
+    }
+
+    return (top);
+}
+
+template <typename T, std::size_t LEVELS, typename LEVEL_OF>
+std::size_t BucketQueue<T, LEVELS, LEVEL_OF>::Highest(bitmap_t bitmap)
+{
+    return (sizeof(bitmap_t) * 8 - 1 - __builtin_clzll(bitmap));
+}
+} // namespace nsrd
+
+#endif // NSRD_BUCKET_QUEUE_HPP
@@ -11,12 +11,17 @@
 #ifndef NSRD_PRIORITY_QUEUE_HPP
 #define NSRD_PRIORITY_QUEUE_HPP
 
-#include <queue> // std::priority_queue
+#include <vector> // std::vector
+#include <algorithm> // std::push_heap, std::pop_heap
 #include <functional> // std::less
+#include <utility> // std::move, std::forward
 
 namespace nsrd
 {
-// The behavior is undefined if T is not the same type as Container::value_type. 
+// The behavior is undefined if T is not the same type as Container::value_type.
+// The heap is kept with the std heap algorithms rather than in a
+// std::priority_queue, so that the front may be moved out before pop_front:
+// move-only elements can pass through.
 template < typename T,
            typename CONTAINER = std::vector<T>,
            typename COMPARE = std::less<typename CONTAINER::value_type> >
@@ -27,36 +32,65 @@ public:
     // ~PriorityQueue() = default;
     
     void push_back(const T &data);
+    void push_back(T &&data);
+    template <typename... ARGS>
+    void emplace_back(ARGS&&... args);
     void pop_front();
     const T &front() const;
+    // only pop_front may follow moving the front out
+    T &front();
     bool empty() const;
     
 private:
-    std::priority_queue<T, CONTAINER, COMPARE> m_pqueue;
+    CONTAINER m_heap;
+    COMPARE m_compare;
 };
 
 template <typename T, typename CONTAINER, typename COMPARE>
 void PriorityQueue<T, CONTAINER, COMPARE>::push_back(const T &data)
 {
-    m_pqueue.push(data);
+    m_heap.push_back(data);
+    std::push_heap(m_heap.begin(), m_heap.end(), m_compare);
+}
+
+template <typename T, typename CONTAINER, typename COMPARE>
+void PriorityQueue<T, CONTAINER, COMPARE>::push_back(T &&data)
+{
+    m_heap.push_back(std::move(data));
+    std::push_heap(m_heap.begin(), m_heap.end(), m_compare);
+}
+
+template <typename T, typename CONTAINER, typename COMPARE>
+template <typename... ARGS>
+void PriorityQueue<T, CONTAINER, COMPARE>::emplace_back(ARGS&&... args)
+{
+    m_heap.emplace_back(std::forward<ARGS>(args)...);
+    std::push_heap(m_heap.begin(), m_heap.end(), m_compare);
 }
 
 template <typename T, typename CONTAINER, typename COMPARE>
 void PriorityQueue<T, CONTAINER, COMPARE>::pop_front()
 {
-    m_pqueue.pop();
+    std::pop_heap(m_heap.begin(), m_heap.end(), m_compare);
+    m_heap.pop_back();
 }
 
 template <typename T, typename CONTAINER, typename COMPARE>
 const T &PriorityQueue<T, CONTAINER, COMPARE>::front() const
 {
-    return (m_pqueue.top());
+    return (m_heap.front());
+}
+
+template <typename T, typename CONTAINER, typename COMPARE>
+T &PriorityQueue<T, CONTAINER, COMPARE>::front()
+{
+    return (m_heap.front());
 }
 
 template <typename T, typename CONTAINER, typename COMPARE>
 bool PriorityQueue<T, CONTAINER, COMPARE>::empty() const
 {
-    return (m_pqueue.empty());
+    return (m_heap.empty());
 }
 } // namespace nsrd
 
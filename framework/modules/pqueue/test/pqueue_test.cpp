@@ -10,9 +10,13 @@
 
 #include <vector> // std::vector
 #include <functional> // std::greather
+#include <cstddef> // std::size_t
+#include <utility> // std::pair
+#include <memory> // std::unique_ptr
 
 #include "testing.hpp" // nsrd::testing::Testscmp, nsrd::testing::UnitTest
 #include "pqueue.hpp"
+#include "bucket_queue.hpp"
 
 using namespace nsrd;
 using namespace nsrd::testing;
@@ -20,12 +24,14 @@ using namespace nsrd::testing;
 namespace
 {
 void TestGeneralBehavior(void);
+void TestBucketQueue(void);
 } // namespace
 
 int main()
 {
     Testscmp cmp;
     cmp.AddTest(UnitTest("General behavior", TestGeneralBehavior));
+    cmp.AddTest(UnitTest("Bucket queue", TestBucketQueue));
     cmp.Run();
 
     return (0);
@@ -72,4 +78,90 @@ void TestGeneralBehavior(void)
 
     TH_ASSERT(true == pq2.empty());
 }
+
+typedef std::pair<std::size_t, int> level_value_t; // a level and a sequence
+
+struct LevelOf
+{
+    std::size_t operator()(const level_value_t &element) const
+    {
+        return (element.first);
+    }
+    std::size_t operator()(const std::unique_ptr<std::size_t> &element) const
+    {
+        return (*element);
+    }
+};
+
+void TestBucketQueue(void)
+{
+    const std::size_t LEVELS = 5;
+    BucketQueue<level_value_t, LEVELS, LevelOf> bq1;
+
+    TH_ASSERT(true == bq1.empty());
+
+    for (int i = 0; i < 100; ++i)
+    {
+        bq1.push_back(level_value_t(i % LEVELS, i));
+    }
+
+    TH_ASSERT(false == bq1.empty());
+
+    // the highest level first, each level in the order of pushing
+    for (std::size_t level = LEVELS; 0 < level; --level)
+    {
+        for (int i = static_cast<int>(level) - 1; i < 100; i += LEVELS)
+        {
+            TH_ASSERT(level - 1 == bq1.front().first);
+            TH_ASSERT(i == bq1.front().second);
+            bq1.pop_front();
+        }
+    }
+
+    TH_ASSERT(true == bq1.empty());
+
+    // interleaved, a higher level pushed later still comes out first
+    bq1.push_back(level_value_t(1, 0));
+    bq1.emplace_back(0, 1);
+    TH_ASSERT(0 == bq1.front().second);
+    bq1.push_back(level_value_t(4, 2));
+    TH_ASSERT(2 == bq1.front().second);
+    bq1.pop_front();
+    TH_ASSERT(0 == bq1.front().second);
+    bq1.pop_front();
+    TH_ASSERT(1 == bq1.front().second);
+    bq1.pop_front();
+    TH_ASSERT(true == bq1.empty());
+
+    // move-only elements
+    BucketQueue<std::unique_ptr<std::size_t>, 64, LevelOf> bq2;
+
+    bq2.push_back(std::unique_ptr<std::size_t>(new std::size_t(0)));
+    bq2.emplace_back(new std::size_t(63));
+
+    std::unique_ptr<std::size_t> top = std::move(bq2.front());
+    bq2.pop_front();
+    TH_ASSERT(63 == *top);
+    TH_ASSERT(0 == *bq2.front());
+    bq2.pop_front();
+    TH_ASSERT(true == bq2.empty());
+
+    // with a starvation limit of 2 the lower levels are served every third pop
+    BucketQueue<level_value_t, LEVELS, LevelOf> bq3(2);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        bq3.push_back(level_value_t(4, i));
+    }
+    bq3.push_back(level_value_t(0, 100));
+    bq3.push_back(level_value_t(2, 200));
+
+    std::size_t expected[] = {4, 4, 2, 0, 4, 4, 4, 4, 4, 4, 4, 4};
+    for (std::size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+    {
+        TH_ASSERT(expected[i] == bq3.front().first);
+        bq3.pop_front();
+    }
+    TH_ASSERT(true == bq3.empty());
+}
 } // namespace
@@ -1,20 +1,31 @@
 /*******************************************************************************
 *
 * FILENAME : listener.hpp
-* 
+*
 * AUTHOR : Nick Shenderov
 *
 * DATE : 01.10.2023
-* 
+*
+* Two backends are available, chosen on construction:
+* SELECT rebuilds the fd sets and walks every listened fd on each wakeup and
+* is limited to fds below FD_SETSIZE;
+* EPOLL keeps the registrations in the kernel, updated on Add and Remove, so
+* a wakeup costs only the number of ready fds and fds are not capped.
+*
+* Events may be taken one at a time or all the ready ones at once; Remove
+* drops only the events not yet taken.
+*
 *******************************************************************************/
 
 #ifndef NSRD_LISTENER_HPP
 #define NSRD_LISTENER_HPP
 
 #include <utility> // std::pair
-#include <list> // std::list
 #include <set> // std::set
+#include <vector> // std::vector
+#include <cstdint> // uint8_t, uint32_t
 #include <sys/select.h> // select
+#include <sys/epoll.h> // epoll_event
 #include <time.h> // time
 
 #include "socket_event_type.hpp" // nsrd::SocketEventType
@@ -25,31 +36,46 @@ class Listener
 {
 public:
     using Event = std::pair<int, SocketEventType>;
-    using ReadyList = std::list<Event>;
+    using ReadyList = std::vector<Event>;
+
+    enum Backend {SELECT, EPOLL};
 
-    explicit Listener();
+    explicit Listener(Backend backend = SELECT);
     ~Listener() noexcept;
 
     Listener(const Listener &other) = delete;
     Listener(const Listener &&other) = delete;
     Listener &operator=(const Listener &other) = delete;
     Listener &operator=(const Listener &&other) = delete;
-    
+
     void Add(int fd, SocketEventType type);
     void Remove(int fd, SocketEventType type) noexcept;
-    
+
     Event Listen();
-    
+    // replaces the contents of ready with every event that is ready
+    void Listen(ReadyList &ready);
+
 private:
+    static const int MAX_EPOLL_EVENTS = 64;
+
+    Backend m_backend;
     std::set<Event> m_listened;
     ReadyList m_ready_list;
 
+    int m_epoll_fd;
+    std::vector<uint8_t> m_fd_types; // bitmask of the types listened per fd
+    epoll_event m_epoll_events[MAX_EPOLL_EVENTS];
+
+    void Wait();
     void Select();
     void HandleSelectError();
     void FillUpSets(fd_set *sets);
     void PushToReadyList(fd_set *sets, int nready);
     int GetMaxFd();
     Event PeekAndPopEvent();
+
+    void EpollWait();
+    void PushToReadyList(const epoll_event &event);
 };
 } // namepsace nsrd
 
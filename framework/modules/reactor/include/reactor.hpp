@@ -1,11 +1,28 @@
 /*******************************************************************************
 *
 * FILENAME : reactor.hpp
-* 
+*
 * AUTHOR : Nick Shenderov
 *
 * DATE : 01.10.2023
-* 
+*
+* Besides fd handlers the reactor runs timers, each backed by its own
+* timerfd on CLOCK_MONOTONIC, and callbacks posted from other threads,
+* which wake the loop through an eventfd.
+*
+* Handlers are kept in a table indexed by fd and event type. Run takes all
+* the ready events at once and dispatches them one by one; each table entry
+* carries a generation, bumped by Add and Remove, so an event taken before
+* its handler was removed (or replaced) within the same batch is dropped.
+*
+* Post, Add and Remove are thread safe. While the loop runs, Add and Remove
+* called from another thread are queued to the loop thread and applied there
+* between handlers; such a Remove waits until it has been applied, so once it
+* returns the handler is not running and won't be called again (it must not
+* be called by a thread the loop itself waits for). AddTimer, CancelTimer and
+* Stop are to be called before Run or from the handlers; other threads hand
+* such calls over to the loop with Post.
+*
 *******************************************************************************/
 
 #ifndef NSRD_REACTOR_HPP
@@ -13,8 +30,13 @@
 
 #include <utility> // std::pair
 #include <unordered_map> // std::unordered_map
+#include <vector> // std::vector
+#include <memory> // std::unique_ptr
 #include <cstddef> // std::size_t
 #include <functional> // std::function
+#include <chrono> // std::chrono::nanoseconds
+#include <mutex> // std::mutex
+#include <thread> // std::thread::id
 
 #include "listener.hpp" // nsrd::Listener
 #include "socket_event_type.hpp" // nsrd::SocketEventType
@@ -25,10 +47,11 @@ class Reactor
 {
 public:
     using Handler = std::function<void()>;
-    
-    explicit Reactor();
+    using timer_id_t = std::size_t;
+
+    explicit Reactor(Listener::Backend backend = Listener::SELECT);
     ~Reactor() noexcept;
-    
+
     Reactor(const Reactor &other) = delete;
     Reactor(const Reactor &&other) = delete;
     Reactor &operator=(const Reactor &other) = delete;
@@ -36,18 +59,54 @@ public:
 
     void Add(int fd, const Handler &handler, SocketEventType type);
     void Remove(int fd, SocketEventType type) noexcept;
-    
+
+    // fires once after delay, or every interval after that if it is not zero
+    timer_id_t AddTimer(std::chrono::nanoseconds delay, const Handler &handler,
+                        std::chrono::nanoseconds interval = std::chrono::nanoseconds::zero());
+    // returns false if the timer has already fired (one-shot) or was cancelled
+    bool CancelTimer(timer_id_t id) noexcept;
+
+    // runs the callback on the loop thread
+    void Post(const Handler &callback);
+
     void Run();
     void Stop();
 
 private:
-    using Event = std::pair<int, SocketEventType>;
+    // the handler is boxed, so it stays in place while the table grows
+    struct Slot
+    {
+        std::unique_ptr<Handler> m_handler;
+        std::size_t m_generation;
+    };
 
-    struct PairHash{std::size_t operator()(const Event &p) const noexcept;};
-
-    std::unordered_map<Event, Handler, PairHash> m_fd_func_map;
+    std::vector<Slot> m_handlers; // indexed by fd * SOCKET_EVENT_TYPES + type
     Listener m_listener;
     bool m_is_running;
+
+    Listener::ReadyList m_ready;
+    std::vector<std::size_t> m_ready_generations;
+    bool m_is_dispatching;
+    std::vector<std::unique_ptr<Handler> > m_removed; // freed after the batch
+
+    std::unordered_map<timer_id_t, int> m_timers;
+    timer_id_t m_next_timer_id;
+
+    int m_post_fd;
+    std::vector<Handler> m_posted;
+    std::mutex m_posted_mutex; // guards m_posted, m_is_looping and m_loop_thread
+    bool m_is_looping;
+    std::thread::id m_loop_thread;
+
+    void AddHandler(int fd, const Handler &handler, SocketEventType type);
+    void RemoveHandler(int fd, SocketEventType type) noexcept;
+    bool PostIfForeign(const Handler &command);
+    void Signal();
+    void LeaveLoop();
+    void TimerHandler(timer_id_t id, int fd, const Handler &handler, bool is_periodic);
+    void PostHandler();
+    void Dispatch();
+    static std::size_t Index(int fd, SocketEventType type);
 };
 } // namepsace nsrd
 
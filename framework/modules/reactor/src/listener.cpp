@@ -9,42 +9,196 @@
 *******************************************************************************/
 
 #include <iostream> // std::cerr, std::endl
+#include <string> // std::string
 #include <cstring> // std::strerror
 #include <cerrno> // errno
 #include <cassert> // assert
+#include <stdexcept> // std::invalid_argument, std::runtime_error
+#include <algorithm> // std::remove
+#include <unistd.h> // close
 
 #include "listener.hpp" // nsrd::Listener
 
 using namespace nsrd;
 
-Listener::Listener()
-    : m_listened(), m_ready_list()
-{}
+namespace
+{
+inline uint8_t TypeBit(SocketEventType type)
+{
+    return (static_cast<uint8_t>(1 << type));
+}
+
+uint32_t ToEpollEvents(uint8_t types)
+{
+    uint32_t events = 0;
+
+    if (types & TypeBit(SocketEventType::READ))
+    {
+        events |= EPOLLIN;
+    }
+    if (types & TypeBit(SocketEventType::WRITE))
+    {
+        events |= EPOLLOUT;
+    }
+    if (types & TypeBit(SocketEventType::EXCEPTION))
+    {
+        events |= EPOLLPRI;
+    }
+
+    return (events);
+}
+
+// returns 0 or errno
+int CtlEpoll(int epoll_fd, int fd, uint8_t old_types, uint8_t new_types) noexcept
+{
+    epoll_event event = {};
+    event.events = ToEpollEvents(new_types);
+    event.data.fd = fd;
+
+    if (0 == new_types)
+    {
+        return (-1 == epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &event) ? errno : 0);
+    }
+
+    if (0 != old_types && 0 == epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event))
+    {
+        return (0);
+    }
+
+    // a closed fd leaves the epoll set by itself, its number may be reused
+    if (0 != old_types && ENOENT != errno)
+    {
+        return (errno);
+    }
+
+    return (-1 == epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) ? errno : 0);
+}
+} // namespace anonimus
+
+const int Listener::MAX_EPOLL_EVENTS;
+
+Listener::Listener(Backend backend)
+    : m_backend(backend),
+      m_listened(),
+      m_ready_list(),
+      m_epoll_fd(-1),
+      m_fd_types(),
+      m_epoll_events()
+{
+    if (EPOLL == m_backend)
+    {
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (-1 == m_epoll_fd)
+        {
+            throw std::runtime_error("Listener: couldn't create epoll instance");
+        }
+    }
+}
 
 Listener::~Listener()
-{}
+{
+    if (-1 != m_epoll_fd)
+    {
+        close(m_epoll_fd);
+    }
+}
 
 void Listener::Add(int fd, SocketEventType type)
 {
-    m_listened.insert({fd, type});
+    if (SELECT == m_backend)
+    {
+        m_listened.insert({fd, type});
+        return;
+    }
+
+    if (0 > fd)
+    {
+        throw std::invalid_argument("Invalid file descriptor detected");
+    }
+
+    if (m_fd_types.size() <= static_cast<std::size_t>(fd))
+    {
+        m_fd_types.resize(fd + 1, 0);
+    }
+
+    uint8_t old_types = m_fd_types[fd];
+    uint8_t new_types = old_types | TypeBit(type);
+    if (old_types == new_types)
+    {
+        return;
+    }
+
+    int error = CtlEpoll(m_epoll_fd, fd, old_types, new_types);
+    if (EBADF == error)
+    {
+        throw std::invalid_argument("Invalid file descriptor detected");
+    }
+    else if (0 != error)
+    {
+        throw std::runtime_error(std::string("Listener: epoll_ctl: ") + std::strerror(error));
+    }
+
+    m_fd_types[fd] = new_types;
 }
 
 void Listener::Remove(int fd, SocketEventType type) noexcept
 {
-    m_ready_list.remove({fd, type});
-    m_listened.erase({fd, type});
+    m_ready_list.erase(std::remove(m_ready_list.begin(), m_ready_list.end(), Event(fd, type)),
+                       m_ready_list.end());
+
+    if (SELECT == m_backend)
+    {
+        m_listened.erase({fd, type});
+        return;
+    }
+
+    if (0 > fd || m_fd_types.size() <= static_cast<std::size_t>(fd))
+    {
+        return;
+    }
+
+    uint8_t old_types = m_fd_types[fd];
+    uint8_t new_types = old_types & ~TypeBit(type);
+    if (old_types == new_types)
+    {
+        return;
+    }
+
+    // the fd may have been closed before it was removed, nothing to undo then
+    CtlEpoll(m_epoll_fd, fd, old_types, new_types);
+    m_fd_types[fd] = new_types;
 }
 
 Listener::Event Listener::Listen()
 {
-    if (0 == m_ready_list.size())
-    {
-        Select();
-    }
+    Wait();
 
     return (PeekAndPopEvent());
 }
 
+void Listener::Listen(ReadyList &ready)
+{
+    Wait();
+
+    ready.clear();
+    ready.swap(m_ready_list);
+}
+
+void Listener::Wait()
+{
+    while (m_ready_list.empty())
+    {
+        if (SELECT == m_backend)
+        {
+            Select();
+        }
+        else
+        {
+            EpollWait();
+        }
+    }
+}
+
 void Listener::Select()
 {
     fd_set sets[SocketEventType::SOCKET_EVENT_TYPES] = {0};
@@ -122,4 +276,47 @@ int Listener::GetMaxFd()
 {
     assert(!m_listened.empty());
     return ((*(--m_listened.end())).first + 1);
-}
\ No newline at end of file
+}
+
+void Listener::EpollWait()
+{
+    int nready = epoll_wait(m_epoll_fd, m_epoll_events, MAX_EPOLL_EVENTS, -1);
+
+    if (-1 == nready)
+    {
+        if (EINTR != errno)
+        {
+            throw std::runtime_error(std::string("Listener: epoll_wait: ") + std::strerror(errno));
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < nready; ++i)
+    {
+        PushToReadyList(m_epoll_events[i]);
+    }
+}
+
+void Listener::PushToReadyList(const epoll_event &event)
+{
+    int fd = event.data.fd;
+    uint8_t types = m_fd_types[fd];
+
+    // errors and hangups are reported to every handler of the fd, as select
+    // reports them readable, so that the handlers get to remove the fd
+    uint32_t failure = event.events & (EPOLLERR | EPOLLHUP);
+
+    if ((types & TypeBit(SocketEventType::READ)) && (failure || (event.events & EPOLLIN)))
+    {
+        m_ready_list.push_back({fd, SocketEventType::READ});
+    }
+    if ((types & TypeBit(SocketEventType::WRITE)) && (failure || (event.events & EPOLLOUT)))
+    {
+        m_ready_list.push_back({fd, SocketEventType::WRITE});
+    }
+    if ((types & TypeBit(SocketEventType::EXCEPTION)) && (failure || (event.events & EPOLLPRI)))
+    {
+        m_ready_list.push_back({fd, SocketEventType::EXCEPTION});
+    }
+}
@@ -8,29 +8,237 @@
 *
 *******************************************************************************/
 
-#include <functional> // std::hash
+#include <algorithm> // std::max
+#include <utility> // std::move
+#include <future> // std::promise
 #include <iostream>
+#include <stdexcept> // std::runtime_error
+#include <cstdint> // uint64_t
+#include <unistd.h> // read, write, close
+#include <sys/timerfd.h> // timerfd_create, timerfd_settime
+#include <sys/eventfd.h> // eventfd
+
 #include "reactor.hpp" // nsrd::Reactor
 
 using namespace nsrd;
 
-Reactor::Reactor()
-    : m_fd_func_map(), m_listener(), m_is_running(false)
-{}
+namespace
+{
+timespec ToTimespec(std::chrono::nanoseconds duration)
+{
+    using namespace std::chrono;
+
+    timespec ts;
+    ts.tv_sec = duration_cast<seconds>(duration).count();
+    ts.tv_nsec = (duration - duration_cast<seconds>(duration)).count();
+
+    return (ts);
+}
+} // namespace anonimus
+
+Reactor::Reactor(Listener::Backend backend)
+    : m_handlers(),
+      m_listener(backend),
+      m_is_running(false),
+      m_ready(),
+      m_ready_generations(),
+      m_is_dispatching(false),
+      m_removed(),
+      m_timers(),
+      m_next_timer_id(0),
+      m_post_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      m_posted(),
+      m_posted_mutex(),
+      m_is_looping(false),
+      m_loop_thread()
+{
+    if (-1 == m_post_fd)
+    {
+        throw std::runtime_error("Reactor: couldn't open eventfd");
+    }
+
+    AddHandler(m_post_fd, std::bind(&Reactor::PostHandler, this), SocketEventType::READ);
+}
 
 Reactor::~Reactor() noexcept
-{}
+{
+    for (auto &timer : m_timers)
+    {
+        close(timer.second);
+    }
+
+    close(m_post_fd);
+}
 
 void Reactor::Add(int fd, const Reactor::Handler &handler, SocketEventType type)
 {
-    m_fd_func_map.insert({{fd, type}, handler});
-    m_listener.Add(fd, type);
+    auto command = [this, fd, handler, type]()
+    {
+        try
+        {
+            AddHandler(fd, handler, type);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Reactor: queued Add: " << e.what() << std::endl;
+        }
+    };
+
+    if (!PostIfForeign(command))
+    {
+        AddHandler(fd, handler, type);
+    }
 }
 
 void Reactor::Remove(int fd, SocketEventType type) noexcept
 {
-    m_fd_func_map.erase({fd, type});
+    std::shared_ptr<std::promise<void> > removed(new std::promise<void>());
+    std::future<void> is_removed = removed->get_future();
+
+    auto command = [this, fd, type, removed]()
+    {
+        RemoveHandler(fd, type);
+        removed->set_value();
+    };
+
+    if (PostIfForeign(command))
+    {
+        is_removed.wait();
+        return;
+    }
+
+    RemoveHandler(fd, type);
+}
+
+void Reactor::AddHandler(int fd, const Reactor::Handler &handler, SocketEventType type)
+{
+    if (0 > fd)
+    {
+        throw std::invalid_argument("Invalid file descriptor detected");
+    }
+
+    std::size_t idx = Index(fd, type);
+    if (m_handlers.size() <= idx)
+    {
+        m_handlers.resize(Index(fd + 1, SocketEventType::READ));
+    }
+
+    Slot &slot = m_handlers[idx];
+    if (slot.m_handler)
+    {
+        return;
+    }
+
+    m_listener.Add(fd, type);
+
+    slot.m_handler.reset(new Handler(handler));
+    ++slot.m_generation;
+}
+
+void Reactor::RemoveHandler(int fd, SocketEventType type) noexcept
+{
     m_listener.Remove(fd, type);
+
+    if (0 > fd || m_handlers.size() <= Index(fd, type) || !m_handlers[Index(fd, type)].m_handler)
+    {
+        return;
+    }
+
+    Slot &slot = m_handlers[Index(fd, type)];
+    ++slot.m_generation;
+
+    // the handler may be the one running, e.g. a handler removing itself
+    if (m_is_dispatching)
+    {
+        m_removed.push_back(std::move(slot.m_handler));
+    }
+    else
+    {
+        slot.m_handler.reset();
+    }
+}
+
+Reactor::timer_id_t Reactor::AddTimer(std::chrono::nanoseconds delay, const Handler &handler,
+                                      std::chrono::nanoseconds interval)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (-1 == fd)
+    {
+        throw std::runtime_error("Reactor: couldn't create timerfd");
+    }
+
+    // a zero it_value disarms the timer, so an immediate one fires after 1 ns
+    itimerspec spec;
+    spec.it_value = ToTimespec(std::max(delay, std::chrono::nanoseconds(1)));
+    spec.it_interval = ToTimespec(std::max(interval, std::chrono::nanoseconds::zero()));
+
+    if (-1 == timerfd_settime(fd, 0, &spec, nullptr))
+    {
+        close(fd);
+        throw std::runtime_error("Reactor: couldn't arm timerfd");
+    }
+
+    timer_id_t id = m_next_timer_id++;
+    bool is_periodic = std::chrono::nanoseconds::zero() < interval;
+
+    m_timers[id] = fd;
+    AddHandler(fd, std::bind(&Reactor::TimerHandler, this, id, fd, handler, is_periodic),
+        SocketEventType::READ);
+
+    return (id);
+}
+
+bool Reactor::CancelTimer(timer_id_t id) noexcept
+{
+    auto found = m_timers.find(id);
+    if (m_timers.end() == found)
+    {
+        return (false);
+    }
+
+    int fd = found->second;
+    m_timers.erase(found);
+    RemoveHandler(fd, SocketEventType::READ);
+    close(fd);
+
+    return (true);
+}
+
+void Reactor::Post(const Handler &callback)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_posted_mutex);
+        m_posted.push_back(callback);
+    }
+
+    Signal();
+}
+
+bool Reactor::PostIfForeign(const Handler &command)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_posted_mutex);
+        if (!m_is_looping || std::this_thread::get_id() == m_loop_thread)
+        {
+            return (false);
+        }
+
+        m_posted.push_back(command);
+    }
+
+    Signal();
+
+    return (true);
+}
+
+void Reactor::Signal()
+{
+    uint64_t one = 1;
+    if (-1 == write(m_post_fd, &one, sizeof(one)))
+    {
+        // the counter is only full if the loop is far behind, it is awake then
+        std::cerr << "Reactor: couldn't signal eventfd" << std::endl;
+    }
 }
 
 void Reactor::Run()
@@ -38,10 +246,28 @@ void Reactor::Run()
     if (!m_is_running)
     {
         m_is_running = true;
-        while (m_is_running)
+
+        {
+            std::unique_lock<std::mutex> lock(m_posted_mutex);
+            m_is_looping = true;
+            m_loop_thread = std::this_thread::get_id();
+        }
+
+        try
         {
-            m_fd_func_map[m_listener.Listen()]();
+            while (m_is_running)
+            {
+                m_listener.Listen(m_ready);
+                Dispatch();
+            }
         }
+        catch (...)
+        {
+            LeaveLoop();
+            throw;
+        }
+
+        LeaveLoop();
     }
 }
 
@@ -50,7 +276,94 @@ void Reactor::Stop()
     m_is_running = false;
 }
 
-std::size_t Reactor::PairHash::operator()(const std::pair<int, SocketEventType> &p) const noexcept
+void Reactor::TimerHandler(timer_id_t id, int fd, const Handler &handler, bool is_periodic)
+{
+    uint64_t expirations = 0;
+    if (-1 == read(fd, &expirations, sizeof(expirations)))
+    {
+        return; // spurious wakeup, the timer hasn't expired
+    }
+
+    if (!is_periodic)
+    {
+        CancelTimer(id);
+    }
+
+    handler();
+}
+
+void Reactor::PostHandler()
 {
-    return std::hash<int>()(p.first) ^ std::hash<SocketEventType>()(p.second);
-}
\ No newline at end of file
+    uint64_t count = 0;
+    if (-1 == read(m_post_fd, &count, sizeof(count)))
+    {
+        return;
+    }
+
+    std::vector<Handler> posted;
+    {
+        std::unique_lock<std::mutex> lock(m_posted_mutex);
+        posted.swap(m_posted);
+    }
+
+    for (auto &callback : posted)
+    {
+        callback();
+    }
+}
+
+void Reactor::LeaveLoop()
+{
+    // the loop is leaving, what was queued meanwhile must not be lost, e.g. a
+    // Remove waiting for its command to be applied
+    std::vector<Handler> posted;
+    {
+        std::unique_lock<std::mutex> lock(m_posted_mutex);
+        m_is_looping = false;
+        m_loop_thread = std::thread::id();
+        posted.swap(m_posted);
+    }
+
+    for (auto &callback : posted)
+    {
+        callback();
+    }
+}
+
+void Reactor::Dispatch()
+{
+    m_ready_generations.resize(m_ready.size());
+    for (std::size_t i = 0; i < m_ready.size(); ++i)
+    {
+        m_ready_generations[i] = m_handlers[Index(m_ready[i].first, m_ready[i].second)].m_generation;
+    }
+
+    m_is_dispatching = true;
+
+    try
+    {
+        // events left after Stop are still pending in the kernel for the next Run
+        for (std::size_t i = 0; i < m_ready.size() && m_is_running; ++i)
+        {
+            Slot &slot = m_handlers[Index(m_ready[i].first, m_ready[i].second)];
+            if (slot.m_generation == m_ready_generations[i] && slot.m_handler)
+            {
+                (*slot.m_handler)();
+            }
+        }
+    }
+    catch (...)
+    {
+        m_is_dispatching = false;
+        m_removed.clear();
+        throw;
+    }
+
+    m_is_dispatching = false;
+    m_removed.clear();
+}
+
+std::size_t Reactor::Index(int fd, SocketEventType type)
+{
+    return (static_cast<std::size_t>(fd) * SocketEventType::SOCKET_EVENT_TYPES + type);
+}
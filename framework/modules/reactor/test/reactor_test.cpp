@@ -9,8 +9,10 @@
 *******************************************************************************/
 #include <iostream> // std::cout, std::endl
 #include <thread> // std::thread
+#include <atomic> // std::atomic
 #include <cstring> // std::strlen
-#include <unistd.h> // pipe
+#include <unistd.h> // pipe, pipe2, dup2
+#include <fcntl.h> // O_NONBLOCK
 
 #include "testing.hpp" // nsrd::testing::Testscmp, nsrd::testing::UnitTest
 
@@ -29,6 +31,11 @@ void TestGeneral();
 void TestException();
 void TestMultipleRunCalls();
 void TestRemoveCallback();
+void TestTimers();
+void TestPost();
+void TestEpoll();
+void TestStaleEvents();
+void TestLiveRegistration();
 } // namespace
 
 int main()
@@ -38,6 +45,11 @@ int main()
     cmp.AddTest(UnitTest("Exception", TestException));
     cmp.AddTest(UnitTest("Multiple calls to run()", TestMultipleRunCalls));
     cmp.AddTest(UnitTest("Remove callback", TestRemoveCallback));
+    cmp.AddTest(UnitTest("Timers", TestTimers));
+    cmp.AddTest(UnitTest("Post", TestPost));
+    cmp.AddTest(UnitTest("Epoll", TestEpoll));
+    cmp.AddTest(UnitTest("Stale events", TestStaleEvents));
+    cmp.AddTest(UnitTest("Live registration", TestLiveRegistration));
     cmp.Run();
 
     return (0);
@@ -211,4 +223,222 @@ void TestRemoveCallback()
 
     t.join();
 }
-} // namespace
\ No newline at end of file
+
+void TestTimers()
+{
+    using std::chrono::milliseconds;
+
+    Reactor reactor;
+
+    int one_shot = 0;
+    int periodic = 0;
+    int cancelled = 0;
+
+    reactor.AddTimer(milliseconds(50), [&]() { ++one_shot; });
+    Reactor::timer_id_t periodic_id = reactor.AddTimer(milliseconds(10), [&]() { ++periodic; },
+                                                       milliseconds(10));
+    Reactor::timer_id_t cancelled_id = reactor.AddTimer(milliseconds(100), [&]() { ++cancelled; });
+
+    reactor.AddTimer(milliseconds(30), [&]()
+    {
+        TH_ASSERT(true == reactor.CancelTimer(cancelled_id));
+    });
+
+    reactor.AddTimer(milliseconds(200), [&]()
+    {
+        TH_ASSERT(true == reactor.CancelTimer(periodic_id));
+        reactor.Stop();
+    });
+
+    reactor.Run();
+
+    TH_ASSERT(1 == one_shot);
+    TH_ASSERT(5 < periodic);
+    TH_ASSERT(0 == cancelled);
+    TH_ASSERT(false == reactor.CancelTimer(cancelled_id));
+}
+
+void TestPost()
+{
+    Reactor reactor;
+
+    int posted = 0;
+
+    std::thread t(ReactorDriver, &reactor);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        reactor.Post([&]() { ++posted; });
+    }
+
+    reactor.Post(std::bind(HandlerClose, &reactor));
+
+    t.join();
+
+    TH_ASSERT(100 == posted);
+}
+
+void TestEpoll()
+{
+    Reactor reactor(Listener::EPOLL);
+
+    int fd_writeread[2];
+    TH_ASSERT(-1 != pipe(fd_writeread));
+
+    // past FD_SETSIZE, where select can't go
+    int high_fd = dup2(fd_writeread[0], FD_SETSIZE + 100);
+    TH_ASSERT(-1 != high_fd);
+
+    int reads = 0;
+    reactor.Add(high_fd, [&]()
+    {
+        char buf[10];
+        TH_ASSERT(10 == read(high_fd, buf, 10));
+        ++reads;
+    }, SocketEventType::READ);
+
+    int writes = 0;
+    reactor.Add(fd_writeread[1], [&]()
+    {
+        ++writes;
+        reactor.Remove(fd_writeread[1], SocketEventType::WRITE);
+    }, SocketEventType::WRITE);
+
+    std::thread t(ReactorDriver, &reactor);
+
+    TH_ASSERT(10 == write(fd_writeread[1], "Message 1", 10));
+    TH_ASSERT(10 == write(fd_writeread[1], "Message 2", 10));
+
+    sleep(1);
+
+    reactor.Post(std::bind(HandlerClose, &reactor));
+    t.join();
+
+    TH_ASSERT(2 == reads);
+    TH_ASSERT(1 == writes);
+
+    reactor.Remove(high_fd, SocketEventType::READ);
+    close(high_fd);
+    close(fd_writeread[0]);
+    close(fd_writeread[1]);
+}
+
+void TestStaleEvents()
+{
+    Reactor reactor;
+
+    int fds[2][2];
+    TH_ASSERT(-1 != pipe(fds[0]));
+    TH_ASSERT(-1 != pipe(fds[1]));
+
+    int reused_write_fd = -1;
+    int stale_calls = 0;
+
+    // the reused fd's handler, its pipe is empty until written below
+    auto reused_handler = [&](int fd)
+    {
+        char c;
+        if (0 >= read(fd, &c, 1))
+        {
+            ++stale_calls;
+        }
+        reactor.Stop();
+    };
+
+    // both pipes are ready in the same batch; whichever handler runs first
+    // replaces the other pipe with a new one under the same fd number
+    auto handler = [&](int idx)
+    {
+        char c;
+        TH_ASSERT(1 == read(fds[idx][0], &c, 1));
+
+        if (-1 != reused_write_fd)
+        {
+            return;
+        }
+
+        int other = fds[1 - idx][0];
+        reactor.Remove(other, SocketEventType::READ);
+
+        int reused[2];
+        TH_ASSERT(-1 != pipe2(reused, O_NONBLOCK));
+        TH_ASSERT(-1 != dup2(reused[0], other));
+        close(reused[0]);
+        reused_write_fd = reused[1];
+
+        reactor.Add(other, std::bind(reused_handler, other), SocketEventType::READ);
+    };
+
+    reactor.Add(fds[0][0], std::bind(handler, 0), SocketEventType::READ);
+    reactor.Add(fds[1][0], std::bind(handler, 1), SocketEventType::READ);
+
+    TH_ASSERT(1 == write(fds[0][1], "", 1));
+    TH_ASSERT(1 == write(fds[1][1], "", 1));
+
+    std::thread t(ReactorDriver, &reactor);
+
+    sleep(1);
+
+    TH_ASSERT(1 == write(reused_write_fd, "", 1));
+
+    t.join();
+
+    TH_ASSERT(0 == stale_calls);
+}
+
+void TestLiveRegistration()
+{
+    Reactor reactor(Listener::EPOLL);
+
+    std::thread t(ReactorDriver, &reactor);
+
+    sleep(1);
+
+    const int PIPES = 50;
+    int fds[PIPES][2];
+    std::atomic<int> reads(0);
+
+    // registered from this thread while the loop runs
+    for (int i = 0; i < PIPES; ++i)
+    {
+        TH_ASSERT(-1 != pipe(fds[i]));
+
+        int read_fd = fds[i][0];
+        reactor.Add(read_fd, [read_fd, &reads]()
+        {
+            char c;
+            TH_ASSERT(1 == read(read_fd, &c, 1));
+            ++reads;
+        }, SocketEventType::READ);
+    }
+
+    for (int i = 0; i < PIPES; ++i)
+    {
+        TH_ASSERT(1 == write(fds[i][1], "", 1));
+    }
+
+    sleep(1);
+
+    TH_ASSERT(PIPES == reads);
+
+    // a Remove from another thread is applied by the time it returns
+    for (int i = 0; i < PIPES; ++i)
+    {
+        reactor.Remove(fds[i][0], SocketEventType::READ);
+        TH_ASSERT(1 == write(fds[i][1], "", 1));
+    }
+
+    sleep(1);
+
+    TH_ASSERT(PIPES == reads);
+
+    for (int i = 0; i < PIPES; ++i)
+    {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+
+    reactor.Post(std::bind(HandlerClose, &reactor));
+    t.join();
+}
+} // namespace
@@ -0,0 +1,79 @@
+/*******************************************************************************
+*
+* FILENAME : auto_scaler.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+* Sizes a ThreadPool to its load, between min_threads and max_threads. It
+* starts the pool at min_threads and checks its stats every interval, from a
+* thread of its own, as a decrease waits for the retiring workers to finish
+* their tasks.
+*
+* While tasks wait and every worker is busy, the pool grows by half of its
+* size if the tasks started since the last check waited target_wait or more
+* on average, or if none started at all: the workers are blocked, e.g. on the
+* network, and more of them will get more done. Once nothing has waited and
+* some workers were idle for IDLE_CHECKS checks in a row, half of the idle
+* ones are released.
+*
+* The pool mustn't be resized by anybody else meanwhile. The scaler is to be
+* destroyed before the pool, leaving it at the size it has reached.
+*
+*******************************************************************************/
+
+#ifndef NSRD_AUTO_SCALER_HPP
+#define NSRD_AUTO_SCALER_HPP
+
+#include <cstddef> // std::size_t
+#include <chrono> // std::chrono::nanoseconds
+#include <atomic> // std::atomic
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <thread> // std::thread
+
+#include "thread_pool.hpp" // nsrd::ThreadPool
+
+namespace nsrd
+{
+class AutoScaler
+{
+public:
+    explicit AutoScaler(ThreadPool &pool, std::size_t min_threads, std::size_t max_threads,
+                        std::chrono::nanoseconds target_wait = std::chrono::milliseconds(2),
+                        std::chrono::nanoseconds interval = std::chrono::milliseconds(50));
+    ~AutoScaler() noexcept;
+
+    AutoScaler(const AutoScaler &other) = delete;
+    AutoScaler(AutoScaler &&other) = delete;
+    AutoScaler &operator=(const AutoScaler &other) = delete;
+    AutoScaler &operator=(AutoScaler &&other) = delete;
+
+    std::size_t GetNumOfThreads() const;
+
+private:
+    static const std::size_t IDLE_CHECKS = 10;
+
+    ThreadPool &m_pool;
+    const std::size_t m_min_threads;
+    const std::size_t m_max_threads;
+    const std::chrono::nanoseconds m_target_wait;
+    const std::chrono::nanoseconds m_interval;
+
+    std::atomic<std::size_t> m_threads;
+    std::size_t m_last_started;
+    std::chrono::nanoseconds m_last_total_wait;
+    std::size_t m_idle_checks;
+
+    bool m_run;
+    std::mutex m_mutex; // guards m_run
+    std::condition_variable m_stop_cond;
+    std::thread m_thread;
+
+    void Run();
+    void Check();
+};
+} // namespace nsrd
+
+#endif // NSRD_AUTO_SCALER_HPP
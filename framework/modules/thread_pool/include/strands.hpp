@@ -0,0 +1,93 @@
+/*******************************************************************************
+*
+* FILENAME : strands.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+* Runs tasks on a ThreadPool in lanes by key: the tasks of one key run one at
+* a time, in the order they were added, while those of different keys run in
+* parallel, each on whichever worker gets to it.
+*
+* A task may be added under a range of keys, e.g. the stripes a write spans,
+* and runs once it is first in the lanes of all of them.
+*
+*******************************************************************************/
+
+#ifndef NSRD_STRANDS_HPP
+#define NSRD_STRANDS_HPP
+
+#include <cstddef> // std::size_t
+#include <vector> // std::vector
+#include <memory> // std::unique_ptr
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+
+#include "thread_pool.hpp" // nsrd::ThreadPool
+#include "unique_task.hpp" // nsrd::UniqueTask
+
+namespace nsrd
+{
+class Strands
+{
+public:
+    typedef std::size_t key_t;
+
+    static const std::size_t DEFAULT_LANES_NUM = 1024;
+
+    // keys share the lanes_num lanes by their remainder, those sharing a
+    // lane are ordered with each other too
+    explicit Strands(ThreadPool &pool,
+                     ThreadPool::Priority priority = ThreadPool::Priority::MEDIUM,
+                     std::size_t lanes_num = DEFAULT_LANES_NUM);
+    // waits for the tasks already added to finish
+    ~Strands() noexcept;
+
+    Strands(const Strands &other) = delete;
+    Strands(Strands &&other) = delete;
+    Strands &operator=(const Strands &other) = delete;
+    Strands &operator=(Strands &&other) = delete;
+
+    void Add(key_t key, UniqueTask task);
+    // ordered with the tasks of any of the keys_num keys from first_key on
+    void Add(key_t first_key, std::size_t keys_num, UniqueTask task);
+    // the lanes with tasks waiting or running
+    std::size_t GetLanesNum() const;
+
+private:
+    // reused once run, so a task is queued without an allocation once the
+    // Strands has seen as many at a time before
+    struct Entry
+    {
+        UniqueTask m_task;
+        std::size_t m_first_lane;
+        std::size_t m_blocked; // the lanes it isn't first in yet
+        std::vector<Entry *> m_next; // after it in each of its lanes
+        Entry *m_next_ready;
+    };
+
+    struct Lane
+    {
+        Entry *m_head; // the running or next to run
+        Entry *m_tail;
+    };
+
+    class EntryTask;
+
+    ThreadPool &m_pool;
+    const ThreadPool::Priority m_priority;
+    std::vector<Lane> m_lanes;
+    std::size_t m_busy_lanes;
+    std::vector<std::unique_ptr<Entry> > m_entries; // all ever made
+    std::vector<Entry *> m_free_entries;
+    mutable std::mutex m_lanes_mutex;
+    std::condition_variable m_drained_cond;
+
+    Entry *TakeEntry();
+    std::size_t GetLanePos(const Entry &entry, std::size_t lane) const;
+    void Run(Entry *entry);
+};
+} // namespace nsrd
+
+#endif // NSRD_STRANDS_HPP
@@ -1,18 +1,36 @@
 /*******************************************************************************
 *
 * FILENAME : task.hpp
-* 
+*
 * AUTHOR : Nick Shenderov
 *
 * DATE : 14.09.2023
-* 
+*
+* A FutureTask keeps the value its function returns, constructed in place
+* once the function is done, so T needs no default constructor. Besides the
+* blocking Wait and Get, continuations may be attached with Then: each runs
+* once with the value, on the thread completing the task or, if it is done
+* already, on the one calling Then. A FutureTask runs once; running it again
+* does nothing.
+*
+* WhenAll and WhenAny combine FutureTasks into one, completed from the
+* continuations of the given ones, so no thread waits for them. They keep
+* the given tasks alive until the combined one is done.
+*
 *******************************************************************************/
 
 #ifndef NSRD_TASK_HPP
 #define NSRD_TASK_HPP
 
 #include <functional> // std::funtion
-#include <boost/interprocess/sync/interprocess_semaphore.hpp> 
+#include <memory> // std::shared_ptr
+#include <vector> // std::vector
+#include <mutex> // std::mutex
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+#include <new> // placement new
+#include <type_traits> // std::aligned_storage
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
                // boost::interprocess::interprocess_semaphore
 
 namespace nsrd
@@ -26,31 +44,69 @@ public:
     virtual void operator()() =0;
 };
 
-// T must be Copyable and CopyAssignable, has Default constructor
+// T must be MoveConstructible, and CopyConstructible for WhenAll
 template<typename T>
 class FutureTask : public Task
 {
 public:
-    explicit FutureTask(std::function<T()> &func);
-    
+    typedef std::function<void(const T &)> callback_t;
+
+    explicit FutureTask(const std::function<T()> &func);
+    ~FutureTask() noexcept;
+
+    FutureTask(const FutureTask &other) = delete;
+    FutureTask(FutureTask &&other) = delete;
+    FutureTask &operator=(const FutureTask &other) = delete;
+    FutureTask &operator=(FutureTask &&other) = delete;
+
     void Wait() const;
     const T &Get() const;
     bool IsReady() const;
+    void Then(const callback_t &callback);
 
     void operator()();
 
 private:
-    T m_value;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
     mutable interprocess_semaphore m_sem;
-    bool m_is_ready;
+    std::atomic<bool> m_has_run;
+    std::atomic<bool> m_is_ready;
     std::function<T()> m_function;
+    std::mutex m_callbacks_mutex; // guards m_callbacks and the turn of m_is_ready
+    std::vector<callback_t> m_callbacks;
+
+    const T &Value() const;
 };
 
+// ready with the values of all the tasks, in their order
+template<typename T>
+std::shared_ptr<FutureTask<std::vector<T> > >
+WhenAll(const std::vector<std::shared_ptr<FutureTask<T> > > &futures);
+// ready with the index of the first task done, with 0 if there are none
+template<typename T>
+std::shared_ptr<FutureTask<std::size_t> >
+WhenAny(const std::vector<std::shared_ptr<FutureTask<T> > > &futures);
+
 template<typename T>
-FutureTask<T>::FutureTask(std::function<T()> &func)
-    : m_value(0), m_sem(0), m_is_ready(false), m_function(func)
+FutureTask<T>::FutureTask(const std::function<T()> &func)
+    : m_storage(),
+      m_sem(0),
+      m_has_run(false),
+      m_is_ready(false),
+      m_function(func),
+      m_callbacks_mutex(),
+      m_callbacks()
 {}
 
+template<typename T>
+FutureTask<T>::~FutureTask() noexcept
+{
+    if (m_is_ready)
+    {
+        Value().~T();
+    }
+}
+
 template<typename T>
 void FutureTask<T>::Wait() const
 {
@@ -63,7 +119,7 @@ const T &FutureTask<T>::Get() const
 {
     Wait();
 
-    return (m_value);
+    return (Value());
 }
 
 template<typename T>
@@ -72,13 +128,128 @@ bool FutureTask<T>::IsReady() const
     return (m_is_ready);
 }
 
+template<typename T>
+void FutureTask<T>::Then(const callback_t &callback)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_callbacks_mutex);
+        if (!m_is_ready)
+        {
+            m_callbacks.push_back(callback);
+            return;
+        }
+    }
+
+    callback(Value());
+}
+
 template<typename T>
 void FutureTask<T>::operator()()
 {
-    m_value = m_function();
-    m_is_ready = true;
+    if (m_has_run.exchange(true))
+    {
+        return;
+    }
+
+    new (&m_storage) T(m_function());
+    m_function = std::function<T()>(); // with whatever it holds on to
+
+    std::vector<callback_t> callbacks;
+    {
+        std::unique_lock<std::mutex> lock(m_callbacks_mutex);
+        m_is_ready = true;
+        callbacks.swap(m_callbacks);
+    }
     m_sem.post();
+
+    // released once run, they may hold on to tasks holding on to this one
+    for (auto &callback : callbacks)
+    {
+        callback(Value());
+    }
+}
+
+template<typename T>
+const T &FutureTask<T>::Value() const
+{
+    return (*reinterpret_cast<const T *>(&m_storage));
+}
+
+template<typename T>
+std::shared_ptr<FutureTask<std::vector<T> > >
+WhenAll(const std::vector<std::shared_ptr<FutureTask<T> > > &futures)
+{
+    std::shared_ptr<FutureTask<std::vector<T> > > all(new FutureTask<std::vector<T> >(
+        [futures]()
+        {
+            // called once all of them are done, Get doesn't wait
+            std::vector<T> values;
+            values.reserve(futures.size());
+            for (auto &future : futures)
+            {
+                values.push_back(future->Get());
+            }
+
+            return (values);
+        }));
+
+    if (futures.empty())
+    {
+        (*all)();
+        return (all);
+    }
+
+    std::shared_ptr<std::atomic<std::size_t> > left(
+        new std::atomic<std::size_t>(futures.size()));
+
+    for (auto &future : futures)
+    {
+        future->Then([all, left](const T &)
+        {
+            if (1 == left->fetch_sub(1))
+            {
+                (*all)();
+            }
+        });
+    }
+
+    return (all);
+}
+
+template<typename T>
+std::shared_ptr<FutureTask<std::size_t> >
+WhenAny(const std::vector<std::shared_ptr<FutureTask<T> > > &futures)
+{
+    const std::size_t NONE = static_cast<std::size_t>(-1);
+
+    std::shared_ptr<std::atomic<std::size_t> > first(
+        new std::atomic<std::size_t>(futures.empty() ? 0 : NONE));
+    std::shared_ptr<FutureTask<std::size_t> > any(new FutureTask<std::size_t>(
+        [first]()
+        {
+            return (first->load());
+        }));
+
+    if (futures.empty())
+    {
+        (*any)();
+        return (any);
+    }
+
+    for (std::size_t i = 0; i < futures.size(); ++i)
+    {
+        futures[i]->Then([any, first, i, NONE](const T &)
+        {
+            std::size_t none = NONE;
+            if (first->compare_exchange_strong(none, i))
+            {
+                (*any)();
+            }
+        });
+    }
+
+    return (any);
 }
 } // namespace nsrd
 
-#endif // NSRD_TASK_HPP
\ No newline at end of file
+#endif // NSRD_TASK_HPP
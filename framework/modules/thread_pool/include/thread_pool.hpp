@@ -6,6 +6,10 @@
 *
 * DATE : 14.09.2023
 * 
+* In the SHARED_QUEUE mode (the default) every task goes through one
+* priority queue, a FIFO per priority. In the WORK_STEALING mode each worker
+* has a queue of its own and steals from the others when it runs dry.
+* 
 *******************************************************************************/
 
 #ifndef NSRD_THREAD_POOL_HPP
@@ -15,13 +19,21 @@
 #include <thread> // std::thread
 #include <memory> // std::shared_ptr
 #include <list> // std::list
+#include <vector> // std::vector
+#include <atomic> // std::atomic
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <chrono> // std::chrono::nanoseconds
 #include <boost/interprocess/sync/interprocess_semaphore.hpp> 
                 // boost::interprocess::interprocess_semaphore
 
-#include "pqueue.hpp"
+#include "bucket_queue.hpp"
 #include "waitable_queue.hpp"
+#include "mpmc_ring.hpp"
+#include "placement.hpp"
 
 #include "task.hpp"
+#include "unique_task.hpp"
 
 namespace nsrd
 {
@@ -32,14 +44,32 @@ class ThreadPool
 private:
     class TaskWrapper;
     class ThreadWrapper;
-    class SleepAction;
-    class DieAction;
-    class IdleAction;
+    class WorkerQueue;
+    struct TaskLevel;
 
 public:
     enum Priority { LOW = 0, MEDIUM = 1, HIGH = 2 };
-
-    explicit ThreadPool(std::size_t num_of_threads = std::thread::hardware_concurrency()); 
+    enum Scheduling { SHARED_QUEUE, WORK_STEALING };
+
+    // counters of one priority, each read on its own, an AutoScaler sizes
+    // the pool by them
+    struct Stats
+    {
+        std::size_t m_queued; // added and not started yet
+        std::size_t m_running;
+        std::size_t m_started;
+        std::chrono::nanoseconds m_total_wait; // from Add to the start, of the started
+        std::chrono::nanoseconds m_max_wait;
+    };
+
+    // with a starvation_limit a priority with tasks waiting is served next
+    // once that many tasks of higher priorities were taken past it, 0 runs
+    // the tasks in strict priority order; the i-th worker created is placed
+    // as the i-th thread of the placement
+    explicit ThreadPool(std::size_t num_of_threads = std::thread::hardware_concurrency(),
+                        Scheduling scheduling = SHARED_QUEUE,
+                        std::size_t starvation_limit = 0,
+                        const Placement &placement = Placement()); 
     ~ThreadPool() noexcept;
 
     ThreadPool(ThreadPool &other) = delete;
@@ -49,9 +79,21 @@ public:
 
     void SetNumOfThreads(std::size_t num_of_threads);
     void Add(std::shared_ptr<Task> task, Priority priority);
+    // a small callable reaches a worker without an allocation
+    void Add(UniqueTask task, Priority priority);
+    // at the cost of a single Add: one lock per queue, one wakeup broadcast
+    void AddBatch(const std::vector<std::shared_ptr<Task> > &tasks, Priority priority);
+    void AddBatch(std::vector<UniqueTask> &&tasks, Priority priority);
+    // the range's elements must convert to UniqueTask, move_iterators for
+    // UniqueTasks themselves
+    template <typename ITERATOR>
+    void AddBatch(ITERATOR first, ITERATOR last, Priority priority);
+    // these only set flags and counters the workers check between tasks, a
+    // paused worker holds on to the task it may have just taken
     void Pause();
     void Resume();
     void Stop();
+    Stats GetStats(Priority priority) const;
 
 #ifndef NDEBUG
     std::size_t GetNThreads();
@@ -60,25 +102,90 @@ public:
 
 private:
     enum ExtraPriority { LOWEST = -1, HIGHEST = 3 };
-    enum Action { IDLE = 0, SLEEP = 1, DIE = 2, ACTIONS_AMOUNT };
 
-    WaitableQueue<TaskWrapper, PriorityQueue<TaskWrapper> > m_tasks;
+    static const std::size_t LEVELS = HIGHEST - LOWEST + 1;
+
+    WaitableQueue<TaskWrapper, BucketQueue<TaskWrapper, LEVELS, TaskLevel> > m_tasks;
     std::list<std::shared_ptr<ThreadWrapper> > m_threads;
-    std::shared_ptr<Task> m_actions[ACTIONS_AMOUNT];
 
-    mutable interprocess_semaphore m_pause_sem;
     mutable interprocess_semaphore m_death_sem;
 
-    bool m_run;
-    bool m_pause;
+    std::atomic<bool> m_run;
+    std::atomic<bool> m_pause;
+    std::atomic<std::size_t> m_retiring; // workers yet to leave on a decrease
+    std::mutex m_pause_mutex;
+    std::condition_variable m_pause_cond;
+
+    static const std::size_t PRIORITIES = HIGH + 1;
+    static const std::size_t INJECTION_CAPACITY = 1024;
+    static const std::size_t GRAB_BATCH = 8;
+    typedef MPMCRing<TaskWrapper, INJECTION_CAPACITY> InjectionRing;
+
+    struct Counters
+    {
+        std::atomic<std::size_t> m_queued;
+        std::atomic<std::size_t> m_running;
+        std::atomic<std::size_t> m_started;
+        std::atomic<long long> m_total_wait_ns;
+        std::atomic<long long> m_max_wait_ns;
+    };
+
+    Counters m_counters[PRIORITIES];
+    // passes are counted for the whole pool in the SHARED_QUEUE mode, per
+    // worker slot in the WORK_STEALING one
+    std::size_t m_starvation_limit;
+    Scheduling m_scheduling;
+    // WORK_STEALING: a deque per priority behind a lock of its own, where a
+    // worker's own tasks go; fixed on construction
+    std::vector<std::unique_ptr<WorkerQueue> > m_queues;
+    // WORK_STEALING: the tasks added from outside the workers, spread over
+    // the slots only while full; a worker looks in its own queue, then here,
+    // then steals, moving up to GRAB_BATCH tasks into its own queue
+    std::unique_ptr<InjectionRing> m_injected[PRIORITIES];
+    Placement m_placement;
+    std::size_t m_next_worker; // counts the threads created, for their slots and places
+    std::atomic<std::size_t> m_next_queue; // for the tasks added from outside
+    std::atomic<std::size_t> m_queued_tasks;
+    std::atomic<std::size_t> m_idle_threads;
+    std::mutex m_idle_mutex;
+    std::condition_variable m_idle_cond;
 
     void AddThreads(std::size_t num_of_threads);
     void IncreaseThreads(std::size_t num_of_threads);
     void DecreaseThreads(std::size_t num_of_threads);
     static bool IsThreadDead(const std::shared_ptr<ThreadWrapper> &thread);
     void TakeTasksOut();
-    void TakeAction(Action action_type, Priority priority, std::size_t amount);
+    void Enqueue(TaskWrapper *tasks, std::size_t amount, Priority priority);
+    void NextTask(std::size_t slot, TaskWrapper &task);
+    bool FindTask(std::size_t slot, TaskWrapper &task);
+    bool TakeTask(std::size_t slot, TaskWrapper &task, Priority priority);
+    void CountPasses(std::size_t slot, Priority taken);
+    void CountStart(const TaskWrapper &task);
+    void CountFinish(const TaskWrapper &task);
+    void WakeUp(bool everyone);
+
+    // worker control, checked by the workers between tasks. A decrease is a
+    // count of workers to retire, taken by the first ones to check it. Idle
+    // workers are woken up to check by an empty task ahead of the others in
+    // the SHARED_QUEUE mode, through the idle condition otherwise
+    void WakeWorkers(std::size_t amount);
+    bool TryRetire();
+    void Requeue(TaskWrapper &task);
+    void WaitWhilePaused();
+    bool IsControlPending() const;
 };
+
+template <typename ITERATOR>
+void ThreadPool::AddBatch(ITERATOR first, ITERATOR last, Priority priority)
+{
+    std::vector<UniqueTask> tasks;
+    for (; first != last; ++first)
+    {
+        tasks.push_back(UniqueTask(*first));
+    }
+
+    AddBatch(std::move(tasks), priority);
+}
 } //namespace nsrd
 
 #endif // NSRD_THREAD_POOL_HPP
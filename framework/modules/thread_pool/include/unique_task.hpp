@@ -0,0 +1,241 @@
+/*******************************************************************************
+*
+* FILENAME : unique_task.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+* A move-only void() callable. Callables of up to BUFFER_SIZE bytes that
+* move without throwing are kept inside the object, bigger ones on the heap,
+* so the usual task, a pointer or two with a function, is queued and run
+* without an allocation or a reference count.
+*
+* A std::shared_ptr<Task> converts to a UniqueTask calling it.
+*
+*******************************************************************************/
+
+#ifndef NSRD_UNIQUE_TASK_HPP
+#define NSRD_UNIQUE_TASK_HPP
+
+#include <cstddef> // std::size_t, std::max_align_t, std::nullptr_t
+#include <memory> // std::shared_ptr
+#include <new> // placement new
+#include <type_traits> // std::aligned_storage, std::enable_if, std::decay,
+                       // std::integral_constant
+#include <utility> // std::move, std::forward, std::declval
+
+#include "task.hpp" // nsrd::Task
+
+namespace nsrd
+{
+class UniqueTask
+{
+private:
+    template <typename FUNC>
+    using EnableIfCallable = typename std::enable_if<
+        !std::is_same<typename std::decay<FUNC>::type, UniqueTask>::value,
+        decltype(std::declval<typename std::decay<FUNC>::type &>()())>::type;
+
+public:
+    static const std::size_t BUFFER_SIZE = 48;
+
+    UniqueTask() noexcept;
+    UniqueTask(std::nullptr_t) noexcept;
+    template <typename FUNC, typename = EnableIfCallable<FUNC> >
+    UniqueTask(FUNC &&func);
+    UniqueTask(std::shared_ptr<Task> task);
+    ~UniqueTask() noexcept;
+
+    UniqueTask(UniqueTask &&other) noexcept;
+    UniqueTask &operator=(UniqueTask &&other) noexcept;
+    UniqueTask(const UniqueTask &other) = delete;
+    UniqueTask &operator=(const UniqueTask &other) = delete;
+
+    void operator()();
+    explicit operator bool() const noexcept;
+
+private:
+    // how the stored callable is run, moved and destroyed
+    struct Ops
+    {
+        void (*m_invoke)(void *storage);
+        void (*m_move)(void *from, void *to) noexcept;
+        void (*m_destroy)(void *storage) noexcept;
+    };
+
+    template <typename FUNC>
+    struct InlineOps;
+    template <typename FUNC>
+    struct HeapOps;
+
+    class SharedTask;
+
+    typename std::aligned_storage<BUFFER_SIZE, alignof(std::max_align_t)>::type m_storage;
+    const Ops *m_ops;
+
+    template <typename FUNC>
+    void Construct(FUNC &&func, std::true_type);
+    template <typename FUNC>
+    void Construct(FUNC &&func, std::false_type);
+    void Reset() noexcept;
+};
+
+template <typename FUNC>
+struct UniqueTask::InlineOps
+{
+    static void Invoke(void *storage)
+    {
+        (*static_cast<FUNC *>(storage))();
+    }
+
+    static void Move(void *from, void *to) noexcept
+    {
+        new (to) FUNC(std::move(*static_cast<FUNC *>(from)));
+        static_cast<FUNC *>(from)->~FUNC();
+    }
+
+    static void Destroy(void *storage) noexcept
+    {
+        static_cast<FUNC *>(storage)->~FUNC();
+    }
+
+    static const Ops s_ops;
+};
+
+template <typename FUNC>
+const UniqueTask::Ops UniqueTask::InlineOps<FUNC>::s_ops = {&Invoke, &Move, &Destroy};
+
+template <typename FUNC>
+struct UniqueTask::HeapOps
+{
+    static void Invoke(void *storage)
+    {
+        (**static_cast<FUNC **>(storage))();
+    }
+
+    static void Move(void *from, void *to) noexcept
+    {
+        new (to) FUNC *(*static_cast<FUNC **>(from));
+    }
+
+    static void Destroy(void *storage) noexcept
+    {
+        delete *static_cast<FUNC **>(storage);
+    }
+
+    static const Ops s_ops;
+};
+
+template <typename FUNC>
+const UniqueTask::Ops UniqueTask::HeapOps<FUNC>::s_ops = {&Invoke, &Move, &Destroy};
+
+class UniqueTask::SharedTask
+{
+public:
+    explicit SharedTask(std::shared_ptr<Task> &&task) noexcept : m_task(std::move(task)){}
+    void operator()(){ (*m_task)(); }
+private:
+    std::shared_ptr<Task> m_task;
+};
+
+inline UniqueTask::UniqueTask() noexcept
+    : m_storage(), m_ops(nullptr)
+{}
+
+inline UniqueTask::UniqueTask(std::nullptr_t) noexcept
+    : m_storage(), m_ops(nullptr)
+{}
+
+template <typename FUNC, typename>
+UniqueTask::UniqueTask(FUNC &&func)
+    : m_storage(), m_ops(nullptr)
+{
+    typedef typename std::decay<FUNC>::type func_t;
+
+    Construct(std::forward<FUNC>(func), std::integral_constant<bool,
+              sizeof(func_t) <= BUFFER_SIZE && alignof(func_t) <= alignof(std::max_align_t) &&
+              std::is_nothrow_move_constructible<func_t>::value>());
+}
+
+template <typename FUNC>
+void UniqueTask::Construct(FUNC &&func, std::true_type /* fits inline */)
+{
+    typedef typename std::decay<FUNC>::type func_t;
+
+    new (&m_storage) func_t(std::forward<FUNC>(func));
+    m_ops = &InlineOps<func_t>::s_ops;
+}
+
+template <typename FUNC>
+void UniqueTask::Construct(FUNC &&func, std::false_type /* fits inline */)
+{
+    typedef typename std::decay<FUNC>::type func_t;
+
+    new (&m_storage) func_t *(new func_t(std::forward<FUNC>(func)));
+    m_ops = &HeapOps<func_t>::s_ops;
+}
+
+inline UniqueTask::UniqueTask(std::shared_ptr<Task> task)
+    : m_storage(), m_ops(nullptr)
+{
+    if (task)
+    {
+        new (&m_storage) SharedTask(std::move(task));
+        m_ops = &InlineOps<SharedTask>::s_ops;
+    }
+}
+
+inline UniqueTask::~UniqueTask() noexcept
+{
+    Reset();
+}
+
+inline UniqueTask::UniqueTask(UniqueTask &&other) noexcept
+    : m_storage(), m_ops(other.m_ops)
+{
+    if (m_ops)
+    {
+        m_ops->m_move(&other.m_storage, &m_storage);
+        other.m_ops = nullptr;
+    }
+}
+
+inline UniqueTask &UniqueTask::operator=(UniqueTask &&other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+
+        if (other.m_ops)
+        {
+            other.m_ops->m_move(&other.m_storage, &m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+
+    return (*this);
+}
+
+inline void UniqueTask::operator()()
+{
+    m_ops->m_invoke(&m_storage);
+}
+
+inline UniqueTask::operator bool() const noexcept
+{
+    return (nullptr != m_ops);
+}
+
+inline void UniqueTask::Reset() noexcept
+{
+    if (m_ops)
+    {
+        m_ops->m_destroy(&m_storage);
+        m_ops = nullptr;
+    }
+}
+} // namespace nsrd
+
+#endif // NSRD_UNIQUE_TASK_HPP
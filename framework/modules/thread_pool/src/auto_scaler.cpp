@@ -0,0 +1,133 @@
+/*******************************************************************************
+*
+* FILENAME : auto_scaler.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+*******************************************************************************/
+
+#include <algorithm> // std::max, std::min
+
+#include "auto_scaler.hpp" // nsrd::AutoScaler
+
+using namespace nsrd;
+
+const std::size_t AutoScaler::IDLE_CHECKS;
+
+AutoScaler::AutoScaler(ThreadPool &pool, std::size_t min_threads, std::size_t max_threads,
+                       std::chrono::nanoseconds target_wait, std::chrono::nanoseconds interval)
+    : m_pool(pool),
+      m_min_threads(std::max(min_threads, std::size_t(1))),
+      m_max_threads(std::max(max_threads, m_min_threads)),
+      m_target_wait(target_wait),
+      m_interval(interval),
+      m_threads(m_min_threads),
+      m_last_started(0),
+      m_last_total_wait(0),
+      m_idle_checks(0),
+      m_run(true),
+      m_mutex(),
+      m_stop_cond(),
+      m_thread()
+{
+    for (int priority = ThreadPool::LOW; priority <= ThreadPool::HIGH; ++priority)
+    {
+        ThreadPool::Stats stats = m_pool.GetStats(ThreadPool::Priority(priority));
+        m_last_started += stats.m_started;
+        m_last_total_wait += stats.m_total_wait;
+    }
+
+    m_pool.SetNumOfThreads(m_min_threads);
+    m_thread = std::thread(&AutoScaler::Run, this);
+}
+
+AutoScaler::~AutoScaler() noexcept
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_run = false;
+    }
+    m_stop_cond.notify_one();
+
+    m_thread.join();
+}
+
+std::size_t AutoScaler::GetNumOfThreads() const
+{
+    return (m_threads);
+}
+
+void AutoScaler::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_run)
+    {
+        m_stop_cond.wait_for(lock, m_interval);
+        if (!m_run)
+        {
+            break;
+        }
+
+        lock.unlock();
+        Check();
+        lock.lock();
+    }
+}
+
+void AutoScaler::Check()
+{
+    std::size_t queued = 0;
+    std::size_t running = 0;
+    std::size_t started = 0;
+    std::chrono::nanoseconds total_wait(0);
+
+    for (int priority = ThreadPool::LOW; priority <= ThreadPool::HIGH; ++priority)
+    {
+        ThreadPool::Stats stats = m_pool.GetStats(ThreadPool::Priority(priority));
+        queued += stats.m_queued;
+        running += stats.m_running;
+        started += stats.m_started;
+        total_wait += stats.m_total_wait;
+    }
+
+    std::size_t new_started = started - m_last_started;
+    std::chrono::nanoseconds new_wait = total_wait - m_last_total_wait;
+    m_last_started = started;
+    m_last_total_wait = total_wait;
+
+    std::size_t threads = m_threads;
+    bool is_saturated = 0 < queued && threads <= running;
+    bool is_slow = 0 == new_started ||
+                   m_target_wait * static_cast<long long>(new_started) <= new_wait;
+
+    if (is_saturated && is_slow)
+    {
+        m_idle_checks = 0;
+        threads = std::min(threads + std::max(threads / 2, std::size_t(1)), m_max_threads);
+    }
+    else if (0 == queued && running < threads)
+    {
+        if (IDLE_CHECKS > ++m_idle_checks)
+        {
+            return;
+        }
+
+        m_idle_checks = 0;
+        std::size_t idle = threads - running;
+        threads = std::max(threads - std::max(idle / 2, std::size_t(1)), m_min_threads);
+    }
+    else
+    {
+        m_idle_checks = 0;
+        return;
+    }
+
+    if (threads != m_threads)
+    {
+        m_pool.SetNumOfThreads(threads);
+        m_threads = threads;
+    }
+}
@@ -0,0 +1,175 @@
+/*******************************************************************************
+*
+* FILENAME : strands.cpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 14.09.2023
+*
+*******************************************************************************/
+
+#include <utility> // std::move
+#include <algorithm> // std::min, std::max
+
+#include "strands.hpp" // nsrd::Strands
+
+using namespace nsrd;
+
+const std::size_t Strands::DEFAULT_LANES_NUM;
+
+// small enough to reach the pool without an allocation
+class Strands::EntryTask
+{
+public:
+    EntryTask(Strands *strands, Entry *entry) noexcept;
+    void operator()();
+private:
+    Strands *m_strands;
+    Entry *m_entry;
+};
+
+Strands::EntryTask::EntryTask(Strands *strands, Entry *entry) noexcept
+    : m_strands(strands), m_entry(entry)
+{}
+
+void Strands::EntryTask::operator()()
+{
+    m_strands->Run(m_entry);
+}
+
+Strands::Strands(ThreadPool &pool, ThreadPool::Priority priority, std::size_t lanes_num)
+    : m_pool(pool),
+      m_priority(priority),
+      m_lanes(std::max<std::size_t>(lanes_num, 1), Lane({nullptr, nullptr})),
+      m_busy_lanes(0),
+      m_entries(),
+      m_free_entries(),
+      m_lanes_mutex(),
+      m_drained_cond()
+{}
+
+Strands::~Strands() noexcept
+{
+    std::unique_lock<std::mutex> lock(m_lanes_mutex);
+    m_drained_cond.wait(lock, [this]() { return (0 == m_busy_lanes); });
+}
+
+void Strands::Add(key_t key, UniqueTask task)
+{
+    Add(key, 1, std::move(task));
+}
+
+void Strands::Add(key_t first_key, std::size_t keys_num, UniqueTask task)
+{
+    // a range wider than the lanes takes each of them once
+    std::size_t lanes_num = std::min(std::max<std::size_t>(keys_num, 1), m_lanes.size());
+
+    Entry *entry = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(m_lanes_mutex);
+
+        entry = TakeEntry();
+        entry->m_task = std::move(task);
+        entry->m_first_lane = first_key % m_lanes.size();
+        entry->m_blocked = 0;
+        entry->m_next.assign(lanes_num, nullptr);
+
+        for (std::size_t pos = 0; pos < lanes_num; ++pos)
+        {
+            std::size_t lane_idx = (entry->m_first_lane + pos) % m_lanes.size();
+            Lane &lane = m_lanes[lane_idx];
+
+            if (nullptr == lane.m_tail)
+            {
+                lane.m_head = entry;
+                ++m_busy_lanes;
+            }
+            else
+            {
+                lane.m_tail->m_next[GetLanePos(*lane.m_tail, lane_idx)] = entry;
+                ++entry->m_blocked;
+            }
+            lane.m_tail = entry;
+        }
+
+        if (0 != entry->m_blocked)
+        {
+            // the last task before it in a lane will get to it
+            return;
+        }
+    }
+
+    m_pool.Add(EntryTask(this, entry), m_priority);
+}
+
+std::size_t Strands::GetLanesNum() const
+{
+    std::unique_lock<std::mutex> lock(m_lanes_mutex);
+
+    return (m_busy_lanes);
+}
+
+Strands::Entry *Strands::TakeEntry()
+{
+    if (m_free_entries.empty())
+    {
+        m_entries.emplace_back(new Entry());
+        return (m_entries.back().get());
+    }
+
+    Entry *entry = m_free_entries.back();
+    m_free_entries.pop_back();
+
+    return (entry);
+}
+
+std::size_t Strands::GetLanePos(const Entry &entry, std::size_t lane) const
+{
+    return ((lane + m_lanes.size() - entry.m_first_lane) % m_lanes.size());
+}
+
+void Strands::Run(Entry *entry)
+{
+    entry->m_task();
+    entry->m_task = UniqueTask();
+
+    // linked through the entries, not to allocate a list of them
+    Entry *ready = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(m_lanes_mutex);
+
+        for (std::size_t pos = 0; pos < entry->m_next.size(); ++pos)
+        {
+            Lane &lane = m_lanes[(entry->m_first_lane + pos) % m_lanes.size()];
+            Entry *next = entry->m_next[pos];
+
+            lane.m_head = next;
+            if (nullptr == next)
+            {
+                lane.m_tail = nullptr;
+                --m_busy_lanes;
+                continue;
+            }
+
+            if (0 == --next->m_blocked)
+            {
+                next->m_next_ready = ready;
+                ready = next;
+            }
+        }
+
+        m_free_entries.push_back(entry);
+
+        if (0 == m_busy_lanes)
+        {
+            m_drained_cond.notify_all();
+        }
+    }
+
+    while (nullptr != ready)
+    {
+        Entry *next_ready = ready->m_next_ready;
+        m_pool.Add(EntryTask(this, ready), m_priority);
+        ready = next_ready;
+    }
+}
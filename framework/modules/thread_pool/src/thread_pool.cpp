@@ -8,6 +8,12 @@
 * 
 *******************************************************************************/
 
+#include <deque> // std::deque
+#include <algorithm> // std::max, std::min, std::move
+#include <iterator> // std::make_move_iterator
+#include <utility> // std::move
+#include <chrono> // std::chrono::steady_clock
+
 #include "thread_pool.hpp"
 
 using namespace nsrd;
@@ -18,14 +24,24 @@ class ThreadPool::TaskWrapper
 {
 public:
     TaskWrapper();
-    explicit TaskWrapper(std::shared_ptr<Task> task, ThreadPool::Priority priority);
+    explicit TaskWrapper(UniqueTask task, ThreadPool::Priority priority);
 
-    void operator()() const;
-    bool operator<(const TaskWrapper &other) const;
+    void operator()();
+    // an empty task only wakes up a worker
+    bool IsEmpty() const;
+    Priority GetPriority() const;
+    std::chrono::steady_clock::time_point GetAddTime() const;
 
 private:
-    std::shared_ptr<Task> m_task;
+    UniqueTask m_task;
     Priority m_priority;
+    std::chrono::steady_clock::time_point m_add_time;
+};
+
+// the level of a task in the shared queue
+struct ThreadPool::TaskLevel
+{
+    std::size_t operator()(const TaskWrapper &task) const;
 };
 
 class ThreadPool::ThreadWrapper
@@ -33,70 +49,46 @@ class ThreadPool::ThreadWrapper
 public:
     enum Status { ALIVE = 0, ASLEEP = 1, DEAD = 2 };
 
-    explicit ThreadWrapper(ThreadPool &pool);
+    explicit ThreadWrapper(ThreadPool &pool, std::size_t slot, std::size_t index);
     ~ThreadWrapper() noexcept;
 
 private:
-    Status m_status;
+    std::atomic<Status> m_status;
     ThreadPool &m_pool;
+    std::size_t m_slot; // the worker queue of the WORK_STEALING mode
+    std::size_t m_index; // in the pool's placement
     std::thread m_thread;
 
     void ThreadWorker();
-    void PerformTask();
 
 friend class ThreadPool;
 };
-class ThreadPool::IdleAction : public Task
-{
-public:
-    IdleAction(const ThreadPool &pool){(void) pool;};
-    void operator()(){};
-private:
-};
-class ThreadPool::SleepAction : public Task
+class ThreadPool::WorkerQueue
 {
 public:
-    SleepAction(const ThreadPool &pool);
-    void operator()();
-private:
-    const ThreadPool &m_pool;
+    WorkerQueue();
 
-    class Sedative : public std::exception
-    {
-    public:
-        std::string what(){return ("Fell asleep");}
-    };
+    // the tasks are moved from
+    void Push(TaskWrapper *tasks, std::size_t amount, Priority priority);
+    // takes up to max of the tasks, but no more than half of them
+    std::size_t Pop(TaskWrapper *tasks, std::size_t max, Priority priority);
+    void Clear();
+    // the starvation limit's count, kept by the workers of the slot
+    std::atomic<std::size_t> &Passes(Priority priority);
 
-friend class ThreadWrapper;
-};
-class ThreadPool::DieAction : public Task
-{
-public:
-    DieAction(const ThreadPool &pool);
-    void operator()();
 private:
-    const ThreadPool &m_pool;
-
-    class Poison : public std::exception
-    {
-    public:
-        std::string what(){return ("Got poisoned");}
-    };
-
-friend class ThreadWrapper;
+    std::mutex m_mutex;
+    std::deque<TaskWrapper> m_tasks[PRIORITIES];
+    std::atomic<std::size_t> m_sizes[PRIORITIES]; // read without the lock
+    std::atomic<std::size_t> m_passes[PRIORITIES];
 };
-
 /* Helpers */
 /* ************************************************************************** */
 namespace
 {
-void SemPostMultiple(interprocess_semaphore &m_sem, std::size_t amount)
-{
-    for (std::size_t i = 0; i < amount; ++i)
-    {
-        m_sem.post();
-    }
-}
+// the pool and worker queue of the current thread, if it is a worker
+thread_local const void *t_pool = nullptr;
+thread_local std::size_t t_slot = 0;
 
 void SemWaitMultiple(interprocess_semaphore &m_sem, std::size_t amount)
 {
@@ -111,18 +103,54 @@ void SemWaitMultiple(interprocess_semaphore &m_sem, std::size_t amount)
 /* ThreadPool */
 /* ************************************************************************** */
 
-ThreadPool::ThreadPool(std::size_t num_of_threads)
-    : m_tasks(),
+const std::size_t ThreadPool::PRIORITIES;
+const std::size_t ThreadPool::INJECTION_CAPACITY;
+const std::size_t ThreadPool::GRAB_BATCH;
+
+ThreadPool::ThreadPool(std::size_t num_of_threads, Scheduling scheduling,
+                       std::size_t starvation_limit, const Placement &placement)
+    : m_tasks(BucketQueue<TaskWrapper, LEVELS, TaskLevel>(starvation_limit)),
       m_threads(), 
-      m_actions(),
-      m_pause_sem(0),
       m_death_sem(0),
       m_run(true),
-      m_pause(false)
+      m_pause(false),
+      m_retiring(0),
+      m_pause_mutex(),
+      m_pause_cond(),
+      m_starvation_limit(starvation_limit),
+      m_scheduling(scheduling),
+      m_queues(),
+      m_placement(placement),
+      m_next_worker(0),
+      m_next_queue(0),
+      m_queued_tasks(0),
+      m_idle_threads(0),
+      m_idle_mutex(),
+      m_idle_cond()
 {
-    m_actions[IDLE] = std::shared_ptr<Task>(new IdleAction(*this));
-    m_actions[SLEEP] = std::shared_ptr<Task>(new SleepAction(*this));
-    m_actions[DIE] = std::shared_ptr<Task>(new DieAction(*this));
+    for (auto &counters : m_counters)
+    {
+        counters.m_queued = 0;
+        counters.m_running = 0;
+        counters.m_started = 0;
+        counters.m_total_wait_ns = 0;
+        counters.m_max_wait_ns = 0;
+    }
+
+    if (WORK_STEALING == m_scheduling)
+    {
+        std::size_t slots = std::max<std::size_t>(std::max<std::size_t>(num_of_threads,
+                                                  std::thread::hardware_concurrency()), 1);
+        for (std::size_t i = 0; i < slots; ++i)
+        {
+            m_queues.emplace_back(new WorkerQueue());
+        }
+
+        for (auto &ring : m_injected)
+        {
+            ring.reset(new InjectionRing());
+        }
+    }
 
     AddThreads(num_of_threads);
 }
@@ -130,26 +158,74 @@ ThreadPool::ThreadPool(std::size_t num_of_threads)
 ThreadPool::~ThreadPool() noexcept
 {
     m_run = false;
-    TakeAction(IDLE, Priority(LOWEST), m_threads.size());
-    Resume();
+    WakeWorkers(m_threads.size());
+
+    // joined before the queues and the idle condition they use go away
+    m_threads.clear();
 }
 
 void ThreadPool::Add(std::shared_ptr<Task> task, ThreadPool::Priority priority)
 {
-    TaskWrapper wrapped_task(task, priority);
-    m_tasks.Push(wrapped_task);
+    Add(UniqueTask(std::move(task)), priority);
+}
+
+void ThreadPool::Add(UniqueTask task, ThreadPool::Priority priority)
+{
+    TaskWrapper wrapped_task(std::move(task), priority);
+    ++m_counters[priority].m_queued;
+
+    if (SHARED_QUEUE == m_scheduling)
+    {
+        m_tasks.Push(std::move(wrapped_task));
+        return;
+    }
+
+    Enqueue(&wrapped_task, 1, priority);
+}
+
+void ThreadPool::AddBatch(const std::vector<std::shared_ptr<Task> > &tasks, Priority priority)
+{
+    AddBatch(tasks.begin(), tasks.end(), priority);
+}
+
+void ThreadPool::AddBatch(std::vector<UniqueTask> &&tasks, Priority priority)
+{
+    std::vector<TaskWrapper> wrapped_tasks;
+    wrapped_tasks.reserve(tasks.size());
+
+    for (auto &task : tasks)
+    {
+        wrapped_tasks.emplace_back(std::move(task), priority);
+    }
+
+    if (wrapped_tasks.empty())
+    {
+        return;
+    }
+    m_counters[priority].m_queued += wrapped_tasks.size();
+
+    if (SHARED_QUEUE == m_scheduling)
+    {
+        m_tasks.PushRange(std::make_move_iterator(wrapped_tasks.begin()),
+                          std::make_move_iterator(wrapped_tasks.end()));
+        return;
+    }
+
+    Enqueue(wrapped_tasks.data(), wrapped_tasks.size(), priority);
 }
 
 void ThreadPool::Pause()
 {
     m_pause = true;
-    TakeAction(SLEEP, Priority(HIGHEST), m_threads.size());
 }
 
 void ThreadPool::Resume()
 {
-    m_pause = false;
-    SemPostMultiple(m_pause_sem, m_threads.size());
+    {
+        std::unique_lock<std::mutex> lock(m_pause_mutex);
+        m_pause = false;
+    }
+    m_pause_cond.notify_all();
 }
 
 void ThreadPool::Stop()
@@ -178,28 +254,23 @@ void ThreadPool::AddThreads(std::size_t num_of_threads)
 {
     for (size_t i = 0; i < num_of_threads; ++i)
     {
-        m_threads.push_back(std::shared_ptr<ThreadWrapper>(new ThreadWrapper(*this)));
+        std::size_t index = m_next_worker++;
+        std::size_t slot = m_queues.empty() ? 0 : index % m_queues.size();
+        m_threads.push_back(std::shared_ptr<ThreadWrapper>(new ThreadWrapper(*this, slot,
+                                                                             index)));
     }
 }
 
 void ThreadPool::IncreaseThreads(std::size_t threads_to_add)
 {
-    if (m_pause)
-    {
-        TakeAction(SLEEP, Priority(HIGHEST), threads_to_add);
-    }
-
+    // the new threads see the pause themselves
     AddThreads(threads_to_add);
 }
 
 void ThreadPool::DecreaseThreads(std::size_t threads_to_kill)
 {
-    TakeAction(DIE, Priority(HIGHEST), threads_to_kill);
-
-    if (m_pause)
-    {
-        SemPostMultiple(m_pause_sem, threads_to_kill);
-    }
+    m_retiring += threads_to_kill;
+    WakeWorkers(threads_to_kill);
 
     SemWaitMultiple(m_death_sem, threads_to_kill);
 
@@ -211,23 +282,278 @@ bool ThreadPool::IsThreadDead(const std::shared_ptr<ThreadWrapper> &thread)
     return (ThreadWrapper::DEAD == thread->m_status);
 }
 
-void ThreadPool::TakeAction(Action action_type, Priority priority, std::size_t amount)
+void ThreadPool::TakeTasksOut()
 {
-    TaskWrapper wrapped_task(m_actions[action_type], priority);
+    TaskWrapper dummy;
+    while (!m_tasks.IsEmpty())
+    {
+        m_tasks.Pop(dummy);
+    }
 
-    for (std::size_t i = 0; i < amount; ++i)
+    // called with no threads left, nobody else touches the queues
+    for (auto &queue : m_queues)
+    {
+        queue->Clear();
+    }
+    for (std::size_t i = 0; i < PRIORITIES && m_injected[i]; ++i)
+    {
+        while (m_injected[i]->TryPop(dummy))
+        {}
+    }
+    m_queued_tasks = 0;
+
+    for (auto &counters : m_counters)
     {
-        m_tasks.Push(wrapped_task);
+        counters.m_queued = 0;
     }
 }
 
-void ThreadPool::TakeTasksOut()
+void ThreadPool::Enqueue(TaskWrapper *tasks, std::size_t amount, Priority priority)
 {
-    TaskWrapper dummy;
-    while (!m_tasks.IsEmpty())
+    // a task added by a worker stays with it, the others go to the ring and
+    // are spread around only if it is full
+    if (this == t_pool)
     {
-        m_tasks.Pop(dummy);
+        m_queues[t_slot]->Push(tasks, amount, priority);
+    }
+    else
+    {
+        for (std::size_t i = 0; i < amount; ++i)
+        {
+            if (!m_injected[priority]->TryPush(std::move(tasks[i])))
+            {
+                m_queues[m_next_queue++ % m_queues.size()]->Push(tasks + i, 1, priority);
+            }
+        }
+    }
+    m_queued_tasks += amount;
+
+    if (0 < m_idle_threads)
+    {
+        WakeUp(1 < amount);
+    }
+}
+
+void ThreadPool::NextTask(std::size_t slot, TaskWrapper &task)
+{
+    if (SHARED_QUEUE == m_scheduling)
+    {
+        m_tasks.Pop(task); // may be an empty task, pushed to wake the worker
+        return;
+    }
+
+    while (true)
+    {
+        if (FindTask(slot, task))
+        {
+            --m_queued_tasks;
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idle_mutex);
+        ++m_idle_threads;
+        while (0 == m_queued_tasks && !IsControlPending())
+        {
+            m_idle_cond.wait(lock);
+        }
+        --m_idle_threads;
+
+        if (IsControlPending())
+        {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::FindTask(std::size_t slot, TaskWrapper &task)
+{
+    // the starved priorities go first, then all of them, the highest first
+    for (int starved = (0 != m_starvation_limit); starved >= 0; --starved)
+    {
+        for (int priority = HIGH; priority >= LOW; --priority)
+        {
+            if (starved && m_starvation_limit > m_queues[slot]->Passes(Priority(priority)))
+            {
+                continue;
+            }
+
+            if (TakeTask(slot, task, Priority(priority)))
+            {
+                CountPasses(slot, Priority(priority));
+                return (true);
+            }
+        }
+    }
+
+    return (false);
+}
+
+bool ThreadPool::TakeTask(std::size_t slot, TaskWrapper &task, Priority priority)
+{
+    if (m_queues[slot]->Pop(&task, 1, priority))
+    {
+        return (true);
+    }
+
+    TaskWrapper grabbed[GRAB_BATCH];
+    std::size_t amount = 0;
+    while (amount < GRAB_BATCH && m_injected[priority]->TryPop(grabbed[amount]))
+    {
+        ++amount;
+    }
+
+    for (std::size_t i = 1; 0 == amount && i < m_queues.size(); ++i)
+    {
+        amount = m_queues[(slot + i) % m_queues.size()]->Pop(grabbed, GRAB_BATCH, priority);
+    }
+
+    if (0 < amount)
+    {
+        // the rest stays with this worker, still open to stealing
+        task = std::move(grabbed[0]);
+        m_queues[slot]->Push(grabbed + 1, amount - 1, priority);
+
+        return (true);
+    }
+
+    return (false);
+}
+
+void ThreadPool::CountPasses(std::size_t slot, Priority taken)
+{
+    if (0 == m_starvation_limit)
+    {
+        return;
+    }
+
+    m_queues[slot]->Passes(taken) = 0;
+    for (int priority = taken - 1; priority >= LOW; --priority)
+    {
+        if (0 < m_counters[priority].m_queued)
+        {
+            ++m_queues[slot]->Passes(Priority(priority));
+        }
+    }
+}
+
+void ThreadPool::CountStart(const TaskWrapper &task)
+{
+    using namespace std::chrono;
+
+    Counters &counters = m_counters[task.GetPriority()];
+    long long wait_ns = duration_cast<nanoseconds>(steady_clock::now() -
+                                                   task.GetAddTime()).count();
+
+    --counters.m_queued;
+    ++counters.m_running;
+    ++counters.m_started;
+    counters.m_total_wait_ns += wait_ns;
+
+    long long max_wait_ns = counters.m_max_wait_ns.load();
+    while (max_wait_ns < wait_ns &&
+           !counters.m_max_wait_ns.compare_exchange_weak(max_wait_ns, wait_ns))
+    {}
+}
+
+void ThreadPool::WakeUp(bool everyone)
+{
+    std::unique_lock<std::mutex> lock(m_idle_mutex);
+
+    if (everyone)
+    {
+        m_idle_cond.notify_all();
     }
+    else
+    {
+        m_idle_cond.notify_one();
+    }
+}
+
+void ThreadPool::WakeWorkers(std::size_t amount)
+{
+    // the flags are set already, taking the lock makes sure that a worker
+    // about to sleep either sees them or gets notified
+    {
+        std::unique_lock<std::mutex> lock(m_pause_mutex);
+    }
+    m_pause_cond.notify_all();
+
+    if (SHARED_QUEUE == m_scheduling)
+    {
+        // ahead of every task, so busy workers are not waited for
+        std::vector<TaskWrapper> wake_ups;
+        wake_ups.reserve(amount);
+        for (std::size_t i = 0; i < amount; ++i)
+        {
+            wake_ups.emplace_back(UniqueTask(), Priority(HIGHEST));
+        }
+        m_tasks.PushRange(std::make_move_iterator(wake_ups.begin()),
+                          std::make_move_iterator(wake_ups.end()));
+    }
+    else
+    {
+        WakeUp(true);
+    }
+}
+
+bool ThreadPool::TryRetire()
+{
+    std::size_t retiring = m_retiring.load();
+
+    while (0 < retiring)
+    {
+        if (m_retiring.compare_exchange_weak(retiring, retiring - 1))
+        {
+            return (true);
+        }
+    }
+
+    return (false);
+}
+
+void ThreadPool::Requeue(TaskWrapper &task)
+{
+    if (SHARED_QUEUE == m_scheduling)
+    {
+        m_tasks.Push(std::move(task));
+    }
+    else
+    {
+        Enqueue(&task, 1, task.GetPriority());
+    }
+}
+
+void ThreadPool::CountFinish(const TaskWrapper &task)
+{
+    --m_counters[task.GetPriority()].m_running;
+}
+
+ThreadPool::Stats ThreadPool::GetStats(Priority priority) const
+{
+    const Counters &counters = m_counters[priority];
+
+    Stats stats;
+    stats.m_queued = counters.m_queued;
+    stats.m_running = counters.m_running;
+    stats.m_started = counters.m_started;
+    stats.m_total_wait = std::chrono::nanoseconds(counters.m_total_wait_ns);
+    stats.m_max_wait = std::chrono::nanoseconds(counters.m_max_wait_ns);
+
+    return (stats);
+}
+
+void ThreadPool::WaitWhilePaused()
+{
+    std::unique_lock<std::mutex> lock(m_pause_mutex);
+    while (m_pause && m_run && 0 == m_retiring)
+    {
+        m_pause_cond.wait(lock);
+    }
+}
+
+bool ThreadPool::IsControlPending() const
+{
+    return (!m_run || 0 < m_retiring);
 }
 
 /* Task */
@@ -240,28 +566,108 @@ Task::~Task() noexcept
 /* ************************************************************************** */
 
 ThreadPool::TaskWrapper::TaskWrapper()
+    : m_task(), m_priority(LOW), m_add_time()
 {}
 
-ThreadPool::TaskWrapper::TaskWrapper(std::shared_ptr<Task> task, ThreadPool::Priority priority)
-    : m_task(task), m_priority(priority)
+ThreadPool::TaskWrapper::TaskWrapper(UniqueTask task, ThreadPool::Priority priority)
+    : m_task(std::move(task)), m_priority(priority),
+      m_add_time(std::chrono::steady_clock::now())
 {}
 
-void ThreadPool::TaskWrapper::operator()() const
+void ThreadPool::TaskWrapper::operator()()
 {
-    (*m_task)();
+    m_task();
 }
 
-bool ThreadPool::TaskWrapper::operator<(const ThreadPool::TaskWrapper &other) const
+std::size_t ThreadPool::TaskLevel::operator()(const TaskWrapper &task) const
 {
-    return (m_priority < other.m_priority);
+    return (static_cast<std::size_t>(task.GetPriority() - LOWEST));
+}
+
+bool ThreadPool::TaskWrapper::IsEmpty() const
+{
+    return (!m_task);
+}
+
+ThreadPool::Priority ThreadPool::TaskWrapper::GetPriority() const
+{
+    return (m_priority);
+}
+
+std::chrono::steady_clock::time_point ThreadPool::TaskWrapper::GetAddTime() const
+{
+    return (m_add_time);
+}
+
+/* WorkerQueue */
+/* ************************************************************************** */
+
+ThreadPool::WorkerQueue::WorkerQueue()
+    : m_mutex(), m_tasks()
+{
+    for (std::size_t i = 0; i < PRIORITIES; ++i)
+    {
+        m_sizes[i] = 0;
+        m_passes[i] = 0;
+    }
+}
+
+void ThreadPool::WorkerQueue::Push(TaskWrapper *tasks, std::size_t amount, Priority priority)
+{
+    if (0 == amount)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_tasks[priority].insert(m_tasks[priority].end(), std::make_move_iterator(tasks),
+                             std::make_move_iterator(tasks + amount));
+    m_sizes[priority] += amount;
+}
+
+std::size_t ThreadPool::WorkerQueue::Pop(TaskWrapper *tasks, std::size_t max, Priority priority)
+{
+    if (0 == m_sizes[priority].load(std::memory_order_relaxed))
+    {
+        return (0);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::deque<TaskWrapper> &queue = m_tasks[priority];
+    std::size_t amount = std::min(max, (queue.size() + 1) / 2);
+
+    // FIFO for the owner too, the tasks mostly come from outside the pool
+    std::move(queue.begin(), queue.begin() + amount, tasks);
+    queue.erase(queue.begin(), queue.begin() + amount);
+    m_sizes[priority] -= amount;
+
+    return (amount);
+}
+
+void ThreadPool::WorkerQueue::Clear()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (std::size_t i = 0; i < PRIORITIES; ++i)
+    {
+        m_tasks[i].clear();
+        m_sizes[i] = 0;
+    }
+}
+
+std::atomic<std::size_t> &ThreadPool::WorkerQueue::Passes(Priority priority)
+{
+    return (m_passes[priority]);
 }
 
 /* ThreadWrapper */
 /* ************************************************************************** */
 
-ThreadPool::ThreadWrapper::ThreadWrapper(ThreadPool &pool)
+ThreadPool::ThreadWrapper::ThreadWrapper(ThreadPool &pool, std::size_t slot,
+                                         std::size_t index)
     :  m_status(ALIVE),
        m_pool(pool),
+       m_slot(slot),
+       m_index(index),
        m_thread(std::thread(&ThreadPool::ThreadWrapper::ThreadWorker, this))
 {}
 
@@ -272,57 +678,54 @@ ThreadPool::ThreadWrapper::~ThreadWrapper() noexcept
 
 void ThreadPool::ThreadWrapper::ThreadWorker()
 {
+    t_pool = &m_pool;
+    t_slot = m_slot;
+
+    // best effort, an unplaced worker still works
+    m_pool.m_placement.Apply(m_index);
+
+    TaskWrapper task; // a task taken right before a pause waits here
+
     while (m_pool.m_run)
     {
-        try
-        {
-            PerformTask();
-        }
-        catch(SleepAction::Sedative &p)
+        if (m_pool.m_pause)
         {
             m_status = ASLEEP;
-            m_pool.m_pause_sem.wait();
+            m_pool.WaitWhilePaused();
             m_status = ALIVE;
         }
-        catch(DieAction::Poison &p)
+
+        if (m_pool.TryRetire())
         {
+            if (!task.IsEmpty())
+            {
+                m_pool.Requeue(task);
+            }
+
             m_status = DEAD;
             m_pool.m_death_sem.post();
             break;
         }
-    }
-}
 
-void ThreadPool::ThreadWrapper::PerformTask()
-{
-    TaskWrapper task;
-    m_pool.m_tasks.Pop(task);
-    task();
-}
-
-/* Action */
-/* ************************************************************************** */
-
-/* Sleep */
-
-nsrd::ThreadPool::SleepAction::SleepAction(const ThreadPool &pool)
-    : m_pool(pool)
-{}
-
-void ThreadPool::SleepAction::operator()()
-{
-    throw Sedative();
-}
-
-/* Die */
+        if (m_pool.m_pause)
+        {
+            continue;
+        }
 
-ThreadPool::DieAction::DieAction(const ThreadPool &pool)
-    : m_pool(pool)
-{}
+        if (task.IsEmpty())
+        {
+            m_pool.NextTask(m_slot, task);
+        }
 
-void ThreadPool::DieAction::operator()()
-{
-    throw Poison();
+        // checked again, the worker may have waited for the task
+        if (!task.IsEmpty() && !m_pool.m_pause && m_pool.m_run)
+        {
+            m_pool.CountStart(task);
+            task();
+            m_pool.CountFinish(task);
+            task = TaskWrapper();
+        }
+    }
 }
 
 #ifndef NDEBUG
@@ -336,6 +739,6 @@ std::size_t ThreadPool::GetNThreads()
 
 bool ThreadPool::QIsEmpty()
 {
-    return (m_tasks.IsEmpty());
+    return (m_tasks.IsEmpty() && 0 == m_queued_tasks);
 }
 #endif
\ No newline at end of file
@@ -8,8 +8,18 @@
 * 
 *******************************************************************************/
 
+#include <vector> // std::vector
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <memory> // std::unique_ptr
+#include <iterator> // std::make_move_iterator
+#include <thread> // std::this_thread::sleep_for
+#include <sched.h> // sched_getcpu, sched_getaffinity
+
 #include "testing.hpp" // nsrd::testing::Testscmp, nsrd::testing::UnitTest
 #include "thread_pool.hpp" // nsrd::ThreadPool
+#include "auto_scaler.hpp" // nsrd::AutoScaler
+#include "strands.hpp" // nsrd::Strands
 
 using namespace nsrd;
 using namespace nsrd::testing;
@@ -21,6 +31,29 @@ void TestPauseResume();
 void TestSetNThreads();
 void TestStop();
 void TestFuture();
+void TestStealingAddTask();
+void TestStealingPauseResume();
+void TestStealingSetNThreads();
+void TestStealingStop();
+void TestStealingPriority();
+void TestControl();
+void TestAddBatch();
+void TestUniqueTask();
+void TestFifo();
+void TestStarvation();
+void TestAutoScaler();
+void TestPlacement();
+void TestContinuations();
+void TestStrands();
+void TestStrandsAcrossKeys();
+
+void TestControlWith(ThreadPool::Scheduling scheduling);
+void TestAddBatchWith(ThreadPool::Scheduling scheduling);
+void TestAddTaskWith(ThreadPool::Scheduling scheduling);
+void TestPauseResumeWith(ThreadPool::Scheduling scheduling);
+void TestSetNThreadsWith(ThreadPool::Scheduling scheduling);
+void TestStopWith(ThreadPool::Scheduling scheduling);
+void TestStarvationWith(ThreadPool::Scheduling scheduling);
 } // namespace
 
 int main()
@@ -31,6 +64,21 @@ int main()
     cmp.AddTest(UnitTest("SetNThreads", TestSetNThreads));
     cmp.AddTest(UnitTest("Stop", TestStop));
     cmp.AddTest(UnitTest("Future", TestFuture));
+    cmp.AddTest(UnitTest("Work stealing AddTask", TestStealingAddTask));
+    cmp.AddTest(UnitTest("Work stealing PauseResume", TestStealingPauseResume));
+    cmp.AddTest(UnitTest("Work stealing SetNThreads", TestStealingSetNThreads));
+    cmp.AddTest(UnitTest("Work stealing Stop", TestStealingStop));
+    cmp.AddTest(UnitTest("Work stealing Priority", TestStealingPriority));
+    cmp.AddTest(UnitTest("Control of many threads", TestControl));
+    cmp.AddTest(UnitTest("AddBatch", TestAddBatch));
+    cmp.AddTest(UnitTest("UniqueTask", TestUniqueTask));
+    cmp.AddTest(UnitTest("FIFO within a priority", TestFifo));
+    cmp.AddTest(UnitTest("Starvation limit and stats", TestStarvation));
+    cmp.AddTest(UnitTest("AutoScaler", TestAutoScaler));
+    cmp.AddTest(UnitTest("Placement", TestPlacement));
+    cmp.AddTest(UnitTest("FutureTask continuations", TestContinuations));
+    cmp.AddTest(UnitTest("Strands", TestStrands));
+    cmp.AddTest(UnitTest("Strands across keys", TestStrandsAcrossKeys));
     cmp.Run();
 
     return (0);
@@ -50,7 +98,12 @@ private:
 
 void TestAddTask()
 {
-    ThreadPool tp(5);
+    TestAddTaskWith(ThreadPool::SHARED_QUEUE);
+}
+
+void TestAddTaskWith(ThreadPool::Scheduling scheduling)
+{
+    ThreadPool tp(5, scheduling);
 
     TH_ASSERT(true == tp.QIsEmpty());
     TH_ASSERT(5 == tp.GetNThreads());
@@ -79,7 +132,12 @@ std::size_t MyFutureFunc()
 
 void TestPauseResume()
 {
-    ThreadPool tp(5);
+    TestPauseResumeWith(ThreadPool::SHARED_QUEUE);
+}
+
+void TestPauseResumeWith(ThreadPool::Scheduling scheduling)
+{
+    ThreadPool tp(5, scheduling);
 
     std::size_t arr[100] = {0};
 
@@ -119,7 +177,12 @@ void TestPauseResume()
 
 void TestSetNThreads()
 {
-    ThreadPool tp(5);
+    TestSetNThreadsWith(ThreadPool::SHARED_QUEUE);
+}
+
+void TestSetNThreadsWith(ThreadPool::Scheduling scheduling)
+{
+    ThreadPool tp(5, scheduling);
 
     tp.SetNumOfThreads(5);
     sleep(1);
@@ -162,7 +225,12 @@ void TestSetNThreads()
 
 void TestStop()
 {
-    ThreadPool tp(5);
+    TestStopWith(ThreadPool::SHARED_QUEUE);
+}
+
+void TestStopWith(ThreadPool::Scheduling scheduling)
+{
+    ThreadPool tp(5, scheduling);
 
     tp.Stop();
     TH_ASSERT(true == tp.QIsEmpty());
@@ -219,4 +287,677 @@ void TestFuture()
     TH_ASSERT(true == future_task2->IsReady());
     TH_ASSERT(1 == future_task2->Get());
 }
+
+void TestStealingAddTask()
+{
+    TestAddTaskWith(ThreadPool::WORK_STEALING);
+}
+
+void TestStealingPauseResume()
+{
+    TestPauseResumeWith(ThreadPool::WORK_STEALING);
+}
+
+void TestStealingSetNThreads()
+{
+    TestSetNThreadsWith(ThreadPool::WORK_STEALING);
+}
+
+void TestStealingStop()
+{
+    TestStopWith(ThreadPool::WORK_STEALING);
+}
+
+class OrderTask : public Task
+{
+public:
+    OrderTask(std::vector<ThreadPool::Priority> &order, ThreadPool::Priority priority)
+        : m_order(order), m_priority(priority){};
+    void operator()(){ m_order.push_back(m_priority); }
+private:
+    std::vector<ThreadPool::Priority> &m_order;
+    ThreadPool::Priority m_priority;
+};
+
+class SpawnTask : public Task
+{
+public:
+    SpawnTask(ThreadPool &tp, std::atomic<std::size_t> &counter, std::size_t depth)
+        : m_tp(tp), m_counter(counter), m_depth(depth){};
+    void operator()()
+    {
+        ++m_counter;
+        for (std::size_t i = 0; 0 < m_depth && i < 2; ++i)
+        {
+            m_tp.Add(std::shared_ptr<Task>(new SpawnTask(m_tp, m_counter, m_depth - 1)),
+                     ThreadPool::MEDIUM);
+        }
+    }
+private:
+    ThreadPool &m_tp;
+    std::atomic<std::size_t> &m_counter;
+    std::size_t m_depth;
+};
+
+void TestStealingPriority()
+{
+    std::vector<ThreadPool::Priority> order;
+
+    {
+        ThreadPool tp(1, ThreadPool::WORK_STEALING);
+
+        tp.Pause();
+        sleep(1);
+
+        for (std::size_t i = 0; i < 50; ++i)
+        {
+            tp.Add(std::shared_ptr<Task>(new OrderTask(order, ThreadPool::LOW)), ThreadPool::LOW);
+            tp.Add(std::shared_ptr<Task>(new OrderTask(order, ThreadPool::HIGH)), ThreadPool::HIGH);
+        }
+
+        tp.Resume();
+        sleep(1);
+    }
+
+    TH_ASSERT(100 == order.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        TH_ASSERT((50 > i ? ThreadPool::HIGH : ThreadPool::LOW) == order[i]);
+    }
+
+    // tasks added by the workers themselves, 2^11 - 1 of them
+    std::atomic<std::size_t> counter(0);
+    ThreadPool tp(5, ThreadPool::WORK_STEALING);
+    tp.Add(std::shared_ptr<Task>(new SpawnTask(tp, counter, 10)), ThreadPool::MEDIUM);
+    sleep(1);
+
+    TH_ASSERT(2047 == counter);
+    TH_ASSERT(true == tp.QIsEmpty());
+}
+
+void TestControl()
+{
+    TestControlWith(ThreadPool::SHARED_QUEUE);
+    TestControlWith(ThreadPool::WORK_STEALING);
+}
+
+void TestControlWith(ThreadPool::Scheduling scheduling)
+{
+    using namespace std::chrono;
+
+    ThreadPool tp(300, scheduling);
+    sleep(1);
+
+    steady_clock::time_point start = steady_clock::now();
+    tp.Pause();
+    tp.Resume();
+    tp.Pause();
+    TH_ASSERT(milliseconds(10) > steady_clock::now() - start);
+
+    // the tasks taken by the paused workers are handed back on the decrease
+    std::size_t arr[100] = {0};
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        tp.Add(std::shared_ptr<Task>(new MyTask(i, arr)), ThreadPool::LOW);
+    }
+
+    start = steady_clock::now();
+    tp.SetNumOfThreads(3);
+    TH_ASSERT(seconds(1) > steady_clock::now() - start);
+    TH_ASSERT(3 == tp.GetNThreads());
+
+    sleep(1);
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        TH_ASSERT(0 == arr[i]);
+    }
+
+    tp.Resume();
+    sleep(1);
+    TH_ASSERT(true == tp.QIsEmpty());
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        TH_ASSERT(i == arr[i]);
+    }
+
+    tp.SetNumOfThreads(300);
+    start = steady_clock::now();
+    tp.SetNumOfThreads(0);
+    TH_ASSERT(seconds(1) > steady_clock::now() - start);
+    TH_ASSERT(0 == tp.GetNThreads());
+}
+
+void TestAddBatch()
+{
+    TestAddBatchWith(ThreadPool::SHARED_QUEUE);
+    TestAddBatchWith(ThreadPool::WORK_STEALING);
+}
+
+class BatchTask : public Task
+{
+public:
+    BatchTask(ThreadPool &tp, std::atomic<std::size_t> &counter, bool fan_out)
+        : m_tp(tp), m_counter(counter), m_fan_out(fan_out){};
+    void operator()()
+    {
+        ++m_counter;
+
+        // a worker's own batch, it goes to the worker's queue
+        if (m_fan_out)
+        {
+            std::vector<std::shared_ptr<Task> > tasks;
+            for (std::size_t i = 0; i < 10; ++i)
+            {
+                tasks.push_back(std::shared_ptr<Task>(new BatchTask(m_tp, m_counter, false)));
+            }
+            m_tp.AddBatch(tasks, ThreadPool::HIGH);
+        }
+    }
+private:
+    ThreadPool &m_tp;
+    std::atomic<std::size_t> &m_counter;
+    bool m_fan_out;
+};
+
+void TestAddBatchWith(ThreadPool::Scheduling scheduling)
+{
+    ThreadPool tp(5, scheduling);
+    std::size_t arr[3000] = {0};
+
+    tp.Pause();
+
+    std::vector<std::shared_ptr<Task> > tasks;
+    for (std::size_t i = 0; i < 3000; ++i)
+    {
+        tasks.push_back(std::shared_ptr<Task>(new MyTask(i, arr)));
+    }
+    tp.AddBatch(tasks.begin(), tasks.begin() + 1000, ThreadPool::LOW);
+    tp.AddBatch(tasks.begin() + 1000, tasks.end(), ThreadPool::MEDIUM);
+    tp.AddBatch(std::vector<std::shared_ptr<Task> >(), ThreadPool::HIGH);
+
+    TH_ASSERT(false == tp.QIsEmpty());
+
+    tp.Resume();
+    sleep(1);
+
+    TH_ASSERT(true == tp.QIsEmpty());
+    for (std::size_t i = 0; i < 3000; ++i)
+    {
+        TH_ASSERT(i == arr[i]);
+    }
+
+    std::atomic<std::size_t> counter(0);
+    std::vector<std::shared_ptr<Task> > fan_outs;
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        fan_outs.push_back(std::shared_ptr<Task>(new BatchTask(tp, counter, true)));
+    }
+    tp.AddBatch(fan_outs, ThreadPool::MEDIUM);
+    sleep(1);
+
+    TH_ASSERT(1100 == counter);
+    TH_ASSERT(true == tp.QIsEmpty());
+}
+
+// counts its live instances, so moves and destructions can be checked
+template <std::size_t PADDING>
+class CountedCall
+{
+public:
+    CountedCall(std::atomic<int> &calls, std::atomic<int> &alive)
+        : m_calls(calls), m_alive(alive), m_id(new int(0)), m_padding()
+    {
+        ++m_alive;
+    }
+    CountedCall(CountedCall &&other) noexcept
+        : m_calls(other.m_calls), m_alive(other.m_alive), m_id(std::move(other.m_id)),
+          m_padding()
+    {
+        ++m_alive;
+    }
+    ~CountedCall(){ --m_alive; }
+    void operator()(){ ++m_calls; }
+private:
+    std::atomic<int> &m_calls;
+    std::atomic<int> &m_alive;
+    std::unique_ptr<int> m_id; // move-only
+    char m_padding[PADDING];
+};
+
+void TestUniqueTask()
+{
+    std::atomic<int> calls(0);
+    std::atomic<int> alive(0);
+
+    {
+        UniqueTask empty;
+        TH_ASSERT(false == static_cast<bool>(empty));
+
+        UniqueTask small(CountedCall<1>(calls, alive));
+        UniqueTask big(CountedCall<UniqueTask::BUFFER_SIZE>(calls, alive));
+        TH_ASSERT(2 == alive);
+
+        small();
+        big();
+        TH_ASSERT(2 == calls);
+
+        UniqueTask moved(std::move(small));
+        TH_ASSERT(false == static_cast<bool>(small));
+        moved();
+        empty = std::move(big);
+        empty();
+        TH_ASSERT(4 == calls);
+        TH_ASSERT(2 == alive);
+
+        std::size_t arr[1] = {0};
+        UniqueTask shared(std::shared_ptr<Task>(new MyTask(0, arr)));
+        shared();
+        TH_ASSERT(static_cast<bool>(shared));
+    }
+    TH_ASSERT(0 == alive);
+
+    ThreadPool shared_tp(3, ThreadPool::SHARED_QUEUE);
+    ThreadPool stealing_tp(3, ThreadPool::WORK_STEALING);
+    calls = 0;
+
+    std::vector<UniqueTask> batch;
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        shared_tp.Add(CountedCall<8>(calls, alive), ThreadPool::MEDIUM);
+        stealing_tp.Add(CountedCall<8>(calls, alive), ThreadPool::MEDIUM);
+        batch.push_back(CountedCall<8>(calls, alive));
+    }
+    stealing_tp.AddBatch(std::make_move_iterator(batch.begin()),
+                         std::make_move_iterator(batch.end()), ThreadPool::LOW);
+    sleep(1);
+
+    TH_ASSERT(300 == calls);
+    TH_ASSERT(0 == alive); // each was destroyed once it had run
+}
+
+void TestFifo()
+{
+    std::vector<std::size_t> order;
+
+    {
+        ThreadPool tp(1);
+
+        tp.Pause();
+        sleep(1);
+
+        for (std::size_t i = 0; i < 300; ++i)
+        {
+            ThreadPool::Priority priority = static_cast<ThreadPool::Priority>(i % 3);
+            tp.Add([&order, i](){ order.push_back(i); }, priority);
+        }
+
+        tp.Resume();
+        sleep(1);
+    }
+
+    TH_ASSERT(300 == order.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        // HIGH ones first, each priority in the order of adding
+        TH_ASSERT((2 - i / 100) + (i % 100) * 3 == order[i]);
+    }
+}
+
+void TestStarvation()
+{
+    TestStarvationWith(ThreadPool::SHARED_QUEUE);
+    TestStarvationWith(ThreadPool::WORK_STEALING);
+}
+
+void TestStarvationWith(ThreadPool::Scheduling scheduling)
+{
+    using namespace std::chrono;
+
+    const std::size_t LIMIT = 4;
+    std::vector<ThreadPool::Priority> order;
+
+    {
+        ThreadPool tp(1, scheduling, LIMIT);
+
+        tp.Pause();
+        sleep(1);
+
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            tp.Add(std::shared_ptr<Task>(new OrderTask(order, ThreadPool::HIGH)), ThreadPool::HIGH);
+        }
+        for (std::size_t i = 0; i < 10; ++i)
+        {
+            tp.Add(std::shared_ptr<Task>(new OrderTask(order, ThreadPool::LOW)), ThreadPool::LOW);
+        }
+
+        TH_ASSERT(100 == tp.GetStats(ThreadPool::HIGH).m_queued);
+        TH_ASSERT(10 == tp.GetStats(ThreadPool::LOW).m_queued);
+        TH_ASSERT(0 == tp.GetStats(ThreadPool::MEDIUM).m_queued);
+
+        sleep(1);
+        tp.Resume();
+        sleep(1);
+
+        ThreadPool::Stats stats = tp.GetStats(ThreadPool::LOW);
+        TH_ASSERT(0 == stats.m_queued);
+        TH_ASSERT(10 == stats.m_started);
+        TH_ASSERT(milliseconds(500) <= stats.m_max_wait);
+        TH_ASSERT(stats.m_max_wait * 10 >= stats.m_total_wait);
+        TH_ASSERT(100 == tp.GetStats(ThreadPool::HIGH).m_started);
+        TH_ASSERT(0 == tp.GetStats(ThreadPool::MEDIUM).m_started);
+    }
+
+    TH_ASSERT(110 == order.size());
+
+    // a LOW task at least once per LIMIT + 1 tasks, the first HIGH task may
+    // have been taken before the pause began
+    std::size_t lows = 0;
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        if (ThreadPool::LOW == order[i])
+        {
+            TH_ASSERT(i <= (lows + 1) * (LIMIT + 1));
+            ++lows;
+        }
+    }
+    TH_ASSERT(10 == lows);
+}
+
+void TestAutoScaler()
+{
+    using namespace std::chrono;
+
+    ThreadPool tp(3, ThreadPool::WORK_STEALING);
+    std::atomic<std::size_t> done(0);
+
+    {
+        AutoScaler scaler(tp, 1, 16, milliseconds(1), milliseconds(20));
+        TH_ASSERT(1 == scaler.GetNumOfThreads());
+        TH_ASSERT(1 == tp.GetNThreads());
+
+        // blocking tasks, a single thread would take 6.4 seconds
+        for (std::size_t i = 0; i < 128; ++i)
+        {
+            tp.Add([&done](){ std::this_thread::sleep_for(milliseconds(50)); ++done; },
+                   ThreadPool::MEDIUM);
+        }
+
+        std::this_thread::sleep_for(milliseconds(300));
+        TH_ASSERT(8 <= scaler.GetNumOfThreads());
+
+        sleep(2);
+        TH_ASSERT(128 == done);
+
+        // released at rest, half of the idle ones every IDLE_CHECKS checks
+        sleep(2);
+        TH_ASSERT(1 == scaler.GetNumOfThreads());
+    }
+
+    TH_ASSERT(1 == tp.GetNThreads());
+}
+
+void TestPlacement()
+{
+    // the last CPU the process may run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int cpu = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(cpu, &allowed))
+    {
+        --cpu;
+    }
+
+    std::atomic<std::size_t> elsewhere(0);
+    std::atomic<std::size_t> done(0);
+
+    {
+        ThreadPool tp(4, ThreadPool::WORK_STEALING, 0,
+                      Placement(Placement::PER_CPU, std::vector<int>(1, cpu)));
+
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            tp.Add([&, cpu](){ elsewhere += (cpu != sched_getcpu()); ++done; },
+                   ThreadPool::MEDIUM);
+        }
+        sleep(1);
+    }
+
+    TH_ASSERT(100 == done);
+    TH_ASSERT(0 == elsewhere);
+}
+
+// has no default constructor
+class Reply
+{
+public:
+    explicit Reply(std::size_t minion) : m_minion(minion){}
+    std::size_t m_minion;
+};
+
+void TestContinuations()
+{
+    typedef std::shared_ptr<FutureTask<Reply> > reply_future_t;
+
+    ThreadPool tp(8, ThreadPool::WORK_STEALING); // a thread per minion below
+
+    // Then before and after the task is done
+    std::atomic<std::size_t> seen(0);
+    reply_future_t single(new FutureTask<Reply>([](){ return (Reply(7)); }));
+    single->Then([&seen](const Reply &reply){ seen += reply.m_minion; });
+    tp.Add(single, ThreadPool::MEDIUM);
+    single->Wait();
+    single->Then([&seen](const Reply &reply){ seen += reply.m_minion; });
+    TH_ASSERT(7 == single->Get().m_minion);
+    sleep(1);
+    TH_ASSERT(14 == seen);
+
+    // a fan-out to slow minions, nobody waits for the answers but the test
+    std::vector<reply_future_t> replies;
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        replies.emplace_back(new FutureTask<Reply>([i]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50 * (8 - i)));
+            return (Reply(i));
+        }));
+    }
+
+    std::atomic<std::size_t> all_size(0);
+    auto all = WhenAll(replies);
+    all->Then([&all_size](const std::vector<Reply> &values){ all_size = values.size(); });
+    auto any = WhenAny(replies);
+
+    for (auto &reply : replies)
+    {
+        tp.Add(reply, ThreadPool::MEDIUM);
+    }
+
+    TH_ASSERT(7 == any->Get()); // the fastest
+    TH_ASSERT(false == all->IsReady());
+
+    const std::vector<Reply> &values = all->Get();
+    TH_ASSERT(8 == values.size());
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        TH_ASSERT(i == values[i].m_minion);
+    }
+    sleep(1);
+    TH_ASSERT(8 == all_size);
+
+    // combined from nothing, ready at once
+    TH_ASSERT(true == WhenAll(std::vector<reply_future_t>())->IsReady());
+    TH_ASSERT(0 == WhenAny(std::vector<reply_future_t>())->Get());
+}
+
+void TestStrands()
+{
+    const std::size_t KEYS = 4;
+    const std::size_t PER_KEY = 500;
+
+    ThreadPool tp(4, ThreadPool::WORK_STEALING);
+
+    // the tasks of a key one at a time and in order
+    std::vector<std::size_t> order[KEYS];
+    std::atomic<std::size_t> in_lane[KEYS];
+    std::atomic<bool> is_overlapped(false);
+    {
+        Strands strands(tp);
+
+        for (std::size_t key = 0; key < KEYS; ++key)
+        {
+            in_lane[key] = 0;
+        }
+
+        for (std::size_t i = 0; i < PER_KEY; ++i)
+        {
+            for (std::size_t key = 0; key < KEYS; ++key)
+            {
+                strands.Add(key, [key, i, &order, &in_lane, &is_overlapped]()
+                {
+                    if (0 != in_lane[key]++)
+                    {
+                        is_overlapped = true;
+                    }
+                    order[key].push_back(i);
+                    --in_lane[key];
+                });
+            }
+        }
+    } // waits for the lanes
+
+    TH_ASSERT(false == is_overlapped);
+    for (std::size_t key = 0; key < KEYS; ++key)
+    {
+        TH_ASSERT(PER_KEY == order[key].size());
+        for (std::size_t i = 0; i < order[key].size(); ++i)
+        {
+            TH_ASSERT(i == order[key][i]);
+        }
+    }
+
+    // different keys side by side, the same one in turn
+    Strands strands(tp);
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<std::size_t> done(0);
+    for (std::size_t key = 0; key < KEYS; ++key)
+    {
+        strands.Add(key, [&done]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            ++done;
+        });
+    }
+    TH_ASSERT(KEYS == strands.GetLanesNum());
+    while (KEYS != done)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TH_ASSERT(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200 * KEYS));
+
+    start = std::chrono::steady_clock::now();
+    done = 0;
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        strands.Add(KEYS, [&done]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            ++done;
+        });
+    }
+    while (3 != done)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TH_ASSERT(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(300));
+    sleep(1);
+    TH_ASSERT(0 == strands.GetLanesNum());
+}
+
+void TestStrandsAcrossKeys()
+{
+    const std::size_t KEYS = 4;
+    const std::size_t ROUNDS = 300;
+
+    ThreadPool tp(4, ThreadPool::WORK_STEALING);
+
+    // a task of two neighbouring keys is ordered with those of either
+    std::vector<std::size_t> order[KEYS + 1];
+    std::atomic<std::size_t> in_lane[KEYS + 1];
+    std::atomic<bool> is_overlapped(false);
+    std::size_t added[KEYS + 1] = {0};
+    {
+        Strands strands(tp);
+
+        for (std::size_t key = 0; key <= KEYS; ++key)
+        {
+            in_lane[key] = 0;
+        }
+
+        for (std::size_t i = 0; i < ROUNDS; ++i)
+        {
+            std::size_t first = i % KEYS;
+            std::size_t keys_num = (0 == i % 3) ? 2 : 1;
+
+            std::vector<std::size_t> seqs;
+            for (std::size_t key = first; key < first + keys_num; ++key)
+            {
+                seqs.push_back(added[key]++);
+            }
+
+            strands.Add(first, keys_num, [first, seqs, &order, &in_lane, &is_overlapped]()
+            {
+                for (std::size_t j = 0; j < seqs.size(); ++j)
+                {
+                    if (0 != in_lane[first + j]++)
+                    {
+                        is_overlapped = true;
+                    }
+                    order[first + j].push_back(seqs[j]);
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                for (std::size_t j = 0; j < seqs.size(); ++j)
+                {
+                    --in_lane[first + j];
+                }
+            });
+        }
+    } // waits for the lanes
+
+    TH_ASSERT(false == is_overlapped);
+    for (std::size_t key = 0; key <= KEYS; ++key)
+    {
+        TH_ASSERT(added[key] == order[key].size());
+        for (std::size_t i = 0; i < order[key].size(); ++i)
+        {
+            TH_ASSERT(i == order[key][i]);
+        }
+    }
+
+    // keys sharing a lane run in turn, a range wider than the lanes takes
+    // each of them once
+    std::atomic<std::size_t> running(0);
+    std::atomic<std::size_t> done(0);
+    {
+        Strands strands(tp, ThreadPool::Priority::MEDIUM, 2);
+
+        for (std::size_t i = 0; i < 20; ++i)
+        {
+            strands.Add(2 * i, (0 == i % 5) ? 7 : 1, [&running, &done, &is_overlapped]()
+            {
+                if (0 != running++)
+                {
+                    is_overlapped = true;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                --running;
+                ++done;
+            });
+        }
+        TH_ASSERT(2 >= strands.GetLanesNum());
+    }
+    TH_ASSERT(false == is_overlapped);
+    TH_ASSERT(20 == done);
+}
 } // namespace
@@ -0,0 +1,136 @@
+/*******************************************************************************
+*
+* FILENAME : futex_event.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 07.09.2023
+*
+* Lets threads sleep until a lock-free structure changes, without a mutex.
+* A waiter registers with Prepare, checks its condition again and only then
+* Waits with the value Prepare returned; the side making the condition true
+* calls Notify afterwards. Notify costs a fence and a load while nobody
+* sleeps, the futex syscall is made only when someone does.
+*
+*******************************************************************************/
+
+#ifndef NSRD_FUTEX_EVENT_HPP
+#define NSRD_FUTEX_EVENT_HPP
+
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <cstdint> // uint32_t
+#include <ctime> // timespec
+#include <unistd.h> // syscall
+#include <sys/syscall.h> // SYS_futex
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+
+namespace nsrd
+{
+class FutexEvent
+{
+public:
+    FutexEvent();
+    ~FutexEvent() = default;
+
+    FutexEvent(const FutexEvent &other) = delete;
+    FutexEvent(FutexEvent &&other) = delete;
+    FutexEvent &operator=(const FutexEvent &other) = delete;
+    FutexEvent &operator=(FutexEvent &&other) = delete;
+
+    // registers the calling thread as a waiter, to be followed by exactly
+    // one Wait or Cancel
+    uint32_t Prepare();
+    void Cancel();
+    // returns early if Notify was called since Prepare; may wake spuriously
+    void Wait(uint32_t epoch);
+    void Wait(uint32_t epoch, std::chrono::steady_clock::time_point deadline);
+
+    // wakes up to that many of the sleeping waiters
+    void Notify(int wakes = 1);
+
+private:
+    std::atomic<uint32_t> m_epoch; // the futex word
+    std::atomic<uint32_t> m_waiters;
+
+    void FutexWait(uint32_t epoch, const timespec *timeout);
+};
+
+// spins the core without giving it up, for the short waits before sleeping
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+inline FutexEvent::FutexEvent()
+    : m_epoch(0), m_waiters(0)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "FutexEvent: the futex word must be a plain 32 bit integer");
+}
+
+inline uint32_t FutexEvent::Prepare()
+{
+    m_waiters.fetch_add(1);
+    // pairs with the fence in Notify: either Notify sees the waiter or the
+    // waiter's next check sees what was done before Notify
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    return (m_epoch.load());
+}
+
+inline void FutexEvent::Cancel()
+{
+    m_waiters.fetch_sub(1);
+}
+
+inline void FutexEvent::Wait(uint32_t epoch)
+{
+    FutexWait(epoch, nullptr);
+    m_waiters.fetch_sub(1);
+}
+
+inline void FutexEvent::Wait(uint32_t epoch, std::chrono::steady_clock::time_point deadline)
+{
+    using namespace std::chrono;
+
+    nanoseconds left = duration_cast<nanoseconds>(deadline - steady_clock::now());
+    if (nanoseconds::zero() < left)
+    {
+        // FUTEX_WAIT measures a relative timeout on the monotonic clock
+        timespec timeout;
+        timeout.tv_sec = duration_cast<seconds>(left).count();
+        timeout.tv_nsec = (left - duration_cast<seconds>(left)).count();
+
+        FutexWait(epoch, &timeout);
+    }
+
+    m_waiters.fetch_sub(1);
+}
+
+inline void FutexEvent::Notify(int wakes)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (0 != m_waiters.load(std::memory_order_relaxed))
+    {
+        m_epoch.fetch_add(1);
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_epoch), FUTEX_WAKE_PRIVATE, wakes,
+                nullptr, nullptr, 0);
+    }
+}
+
+inline void FutexEvent::FutexWait(uint32_t epoch, const timespec *timeout)
+{
+    // returns at once if m_epoch has moved on, EINTR and timeouts are left
+    // for the caller to re-check its condition
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_epoch), FUTEX_WAIT_PRIVATE, epoch,
+            timeout, nullptr, 0);
+}
+} // namespace nsrd
+
+#endif // NSRD_FUTEX_EVENT_HPP
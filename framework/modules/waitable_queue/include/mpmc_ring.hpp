@@ -0,0 +1,194 @@
+/*******************************************************************************
+*
+* FILENAME : mpmc_ring.hpp
+*
+* AUTHOR : Nick Shenderov
+*
+* DATE : 07.09.2023
+*
+* A bounded lock-free queue for any number of producers and consumers,
+* after Dmitry Vyukov's design. Every cell carries a sequence number telling
+* whether it is ready to be written or read at the current lap, so a push
+* or a pop claims its position with one CAS and never waits for another
+* thread. The positions being claimed sit on cache lines of their own.
+*
+* TryPush and TryPop return false at once if the ring is full or empty;
+* WaitableQueue<T, MPMCRing<T, CAPACITY> > adds the waiting.
+*
+*******************************************************************************/
+
+#ifndef NSRD_MPMC_RING_HPP
+#define NSRD_MPMC_RING_HPP
+
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+#include <cstdint> // intptr_t
+#include <memory> // std::unique_ptr
+#include <utility> // std::move
+
+namespace nsrd
+{
+// CAPACITY must be a power of two
+// T must be DefaultConstructible, its move assignment (and copy assignment,
+// if TryPush(const T &) is used) mustn't throw
+template <typename T, std::size_t CAPACITY = 1024>
+class MPMCRing
+{
+public:
+    typedef T value_type;
+
+    MPMCRing();
+    ~MPMCRing() = default;
+
+    MPMCRing(const MPMCRing &other) = delete;
+    MPMCRing(MPMCRing &&other) = delete;
+    MPMCRing &operator=(const MPMCRing &other) = delete;
+    MPMCRing &operator=(MPMCRing &&other) = delete;
+
+    bool TryPush(const T &data);
+    // data is moved from only if it was pushed
+    bool TryPush(T &&data);
+    bool TryPop(T &dest);
+    // exact only while no push or pop is under way
+    bool IsEmpty() const;
+
+private:
+    static_assert(2 <= CAPACITY && 0 == (CAPACITY & (CAPACITY - 1)),
+                  "MPMCRing: CAPACITY must be a power of two");
+
+    static const std::size_t CACHE_LINE = 64;
+
+    struct Cell
+    {
+        std::atomic<std::size_t> m_sequence;
+        T m_data;
+    };
+
+    // claims the cell of the next push, null if the ring is full
+    Cell *ClaimPush(std::size_t &pos);
+
+    std::unique_ptr<Cell[]> m_cells;
+    char m_pad0[CACHE_LINE];
+    std::atomic<std::size_t> m_enqueue_pos;
+    char m_pad1[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> m_dequeue_pos;
+    char m_pad2[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+};
+
+template <typename T, std::size_t CAPACITY>
+MPMCRing<T, CAPACITY>::MPMCRing()
+    : m_cells(new Cell[CAPACITY]), m_pad0(), m_enqueue_pos(0), m_pad1(), m_dequeue_pos(0), m_pad2()
+{
+    for (std::size_t i = 0; i < CAPACITY; ++i)
+    {
+        m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T, std::size_t CAPACITY>
+typename MPMCRing<T, CAPACITY>::Cell *MPMCRing<T, CAPACITY>::ClaimPush(std::size_t &pos)
+{
+    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        Cell *cell = &m_cells[pos & (CAPACITY - 1)];
+        std::size_t sequence = cell->m_sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (0 == diff)
+        {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                return (cell);
+            }
+        }
+        else if (0 > diff)
+        {
+            return (nullptr); // the cell still holds the previous lap's value
+        }
+        else
+        {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T, std::size_t CAPACITY>
+bool MPMCRing<T, CAPACITY>::TryPush(const T &data)
+{
+    std::size_t pos = 0;
+    Cell *cell = ClaimPush(pos);
+    if (!cell)
+    {
+        return (false);
+    }
+
+    cell->m_data = data;
+    cell->m_sequence.store(pos + 1, std::memory_order_release);
+
+    return (true);
+}
+
+template <typename T, std::size_t CAPACITY>
+bool MPMCRing<T, CAPACITY>::TryPush(T &&data)
+{
+    std::size_t pos = 0;
+    Cell *cell = ClaimPush(pos);
+    if (!cell)
+    {
+        return (false);
+    }
+
+    cell->m_data = std::move(data);
+    cell->m_sequence.store(pos + 1, std::memory_order_release);
+
+    return (true);
+}
+
+template <typename T, std::size_t CAPACITY>
+bool MPMCRing<T, CAPACITY>::TryPop(T &dest)
+{
+    std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    Cell *cell = nullptr;
+
+    while (true)
+    {
+        cell = &m_cells[pos & (CAPACITY - 1)];
+        std::size_t sequence = cell->m_sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+        if (0 == diff)
+        {
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (0 > diff)
+        {
+            return (false); // nothing was written at this lap yet
+        }
+        else
+        {
+            pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // moved out, so the cell doesn't keep the value alive for a whole lap
+    dest = std::move(cell->m_data);
+    cell->m_sequence.store(pos + CAPACITY, std::memory_order_release);
+
+    return (true);
+}
+
+template <typename T, std::size_t CAPACITY>
+bool MPMCRing<T, CAPACITY>::IsEmpty() const
+{
+    std::size_t dequeue_pos = m_dequeue_pos.load();
+
+    return (m_enqueue_pos.load() <= dequeue_pos);
+}
+} // namespace nsrd
+
+#endif // NSRD_MPMC_RING_HPP
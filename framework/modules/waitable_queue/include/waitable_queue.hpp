@@ -14,21 +14,42 @@
 #include <queue> // std::queue
 #include <mutex> // std::timed_mutex
 #include <condition_variable> // std::condition_variable
-#include <chrono> // std::chrono::time_point, std::chrono::system_clock
+#include <chrono> // std::chrono::time_point, std::chrono::steady_clock
+#include <atomic> // std::atomic
+#include <algorithm> // std::max, std::min
+#include <climits> // INT_MAX
+#include <utility> // std::move, std::forward
+
+#include "mpmc_ring.hpp" // nsrd::MPMCRing
+#include "futex_event.hpp" // nsrd::FutexEvent, nsrd::CpuRelax
 
 using std::chrono::nanoseconds;
 
 namespace nsrd
 {
 // CONTAINER should be SequenceContainer and support:
-// pop_front, push_back, front and empty functions
-// T must be Copyable and CopyAssignable
+// pop_front, push_back, emplace_back, front and empty functions
+// T must be MoveConstructible and MoveAssignable, and Copyable for the pushes
+// taking a const reference
+// timeouts and deadlines are measured by the monotonic steady_clock
+//
+// With MPMCRing as the CONTAINER the queue takes no lock: pushes and pops go
+// straight to the ring and a thread finding it empty (or full, for Push)
+// spins for a while before sleeping on a futex. The spin is adaptive, it is
+// lengthened while spinning pays off and shortened while it ends in sleep.
+// The queue is bounded then, Push waits for room and TryPush doesn't.
+//
+// PushRange pushes a whole range at once and wakes the waiters once, PopUpTo
+// waits for the first element and takes up to n of those ready along with
+// it; with the lock-based containers each of them takes the lock once.
 
 template < typename T, typename CONTAINER = std::deque<T> >
 class WaitableQueue
 {
 public:
      WaitableQueue() = default;
+    // for a container needing arguments of its own
+    explicit WaitableQueue(CONTAINER &&queue);
     ~WaitableQueue() = default;
 
     WaitableQueue(WaitableQueue &other) = delete;
@@ -37,8 +58,19 @@ public:
     WaitableQueue &operator=(WaitableQueue &&other) = delete;
     
     void Push(const T& data); 
+    void Push(T&& data);
+    template <typename... ARGS>
+    void Emplace(ARGS&&... args);
+    template <typename ITERATOR>
+    void PushRange(ITERATOR first, ITERATOR last);
     void Pop(T &dest);
     bool Pop(T &dest, nanoseconds timeout);
+    bool Pop(T &dest, std::chrono::steady_clock::time_point deadline);
+    // return the number of elements written to dest, 0 on a timeout
+    template <typename OUTPUT_ITERATOR>
+    std::size_t PopUpTo(OUTPUT_ITERATOR dest, std::size_t n);
+    template <typename OUTPUT_ITERATOR>
+    std::size_t PopUpTo(OUTPUT_ITERATOR dest, std::size_t n, nanoseconds timeout);
     bool IsEmpty() const;
 
 private:
@@ -48,6 +80,11 @@ private:
     void Dequeue(T &dest);
 };
 
+template<class T, class CONTAINER>
+WaitableQueue<T, CONTAINER>::WaitableQueue(CONTAINER &&queue)
+    : m_mutex(), m_has_data(), m_queue(std::move(queue))
+{}
+
 template<class T, class CONTAINER>
 void WaitableQueue<T, CONTAINER>::Push(const T &data)
 {
@@ -57,10 +94,54 @@ void WaitableQueue<T, CONTAINER>::Push(const T &data)
     }
     m_has_data.notify_one();
 }
+template<class T, class CONTAINER>
+void WaitableQueue<T, CONTAINER>::Push(T &&data)
+{
+    {
+        std::unique_lock<std::timed_mutex> lock(m_mutex);
+        m_queue.push_back(std::move(data));
+    }
+    m_has_data.notify_one();
+}
+
+template<class T, class CONTAINER>
+template<typename... ARGS>
+void WaitableQueue<T, CONTAINER>::Emplace(ARGS&&... args)
+{
+    {
+        std::unique_lock<std::timed_mutex> lock(m_mutex);
+        m_queue.emplace_back(std::forward<ARGS>(args)...);
+    }
+    m_has_data.notify_one();
+}
+
+template<class T, class CONTAINER>
+template<typename ITERATOR>
+void WaitableQueue<T, CONTAINER>::PushRange(ITERATOR first, ITERATOR last)
+{
+    std::size_t pushed = 0;
+    {
+        std::unique_lock<std::timed_mutex> lock(m_mutex);
+        for (; first != last; ++first, ++pushed)
+        {
+            m_queue.push_back(*first);
+        }
+    }
+
+    if (1 == pushed)
+    {
+        m_has_data.notify_one();
+    }
+    else if (1 < pushed)
+    {
+        m_has_data.notify_all();
+    }
+}
+
 template<class T, class CONTAINER>
 void nsrd::WaitableQueue<T, CONTAINER>::Dequeue(T &dest)
 {
-    dest = m_queue.front();
+    dest = std::move(m_queue.front());
     m_queue.pop_front();
 }
 
@@ -80,11 +161,13 @@ void WaitableQueue<T, CONTAINER>::Pop(T &dest)
 template<class T, class CONTAINER>
 bool WaitableQueue<T, CONTAINER>::Pop(T &dest, nanoseconds timeout)
 {
-    using std::chrono::system_clock;
-
-    system_clock::time_point timeout_tp(system_clock::now() + timeout);
+    return (Pop(dest, std::chrono::steady_clock::now() + timeout));
+}
 
-    std::unique_lock<std::timed_mutex> timed_lock(m_mutex, timeout_tp);
+template<class T, class CONTAINER>
+bool WaitableQueue<T, CONTAINER>::Pop(T &dest, std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::timed_mutex> timed_lock(m_mutex, deadline);
     if (!timed_lock.owns_lock())
     {
         return (false);
@@ -92,7 +175,7 @@ bool WaitableQueue<T, CONTAINER>::Pop(T &dest, nanoseconds timeout)
 
     while (m_queue.empty())
     {
-        if (std::cv_status::timeout == m_has_data.wait_until(timed_lock, timeout_tp))
+        if (std::cv_status::timeout == m_has_data.wait_until(timed_lock, deadline))
         {
             return (false);
         }
@@ -103,13 +186,367 @@ bool WaitableQueue<T, CONTAINER>::Pop(T &dest, nanoseconds timeout)
     return (true);
 }
 
+template<class T, class CONTAINER>
+template<typename OUTPUT_ITERATOR>
+std::size_t WaitableQueue<T, CONTAINER>::PopUpTo(OUTPUT_ITERATOR dest, std::size_t n)
+{
+    std::unique_lock<std::timed_mutex> lock(m_mutex);
+
+    while (m_queue.empty())
+    {
+        m_has_data.wait(lock);
+    }
+
+    std::size_t popped = 0;
+    for (; popped < n && !m_queue.empty(); ++popped, ++dest)
+    {
+        *dest = std::move(m_queue.front());
+        m_queue.pop_front();
+    }
+
+    return (popped);
+}
+
+template<class T, class CONTAINER>
+template<typename OUTPUT_ITERATOR>
+std::size_t WaitableQueue<T, CONTAINER>::PopUpTo(OUTPUT_ITERATOR dest, std::size_t n,
+                                                 nanoseconds timeout)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::unique_lock<std::timed_mutex> timed_lock(m_mutex, deadline);
+    if (!timed_lock.owns_lock())
+    {
+        return (0);
+    }
+
+    while (m_queue.empty())
+    {
+        if (std::cv_status::timeout == m_has_data.wait_until(timed_lock, deadline))
+        {
+            return (0);
+        }
+    }
+
+    std::size_t popped = 0;
+    for (; popped < n && !m_queue.empty(); ++popped, ++dest)
+    {
+        *dest = std::move(m_queue.front());
+        m_queue.pop_front();
+    }
+
+    return (popped);
+}
+
 template<class T, class CONTAINER>
 bool WaitableQueue<T, CONTAINER>::IsEmpty() const
 {
     std::unique_lock<std::timed_mutex> lock(m_mutex);
     return (m_queue.empty());
 }
-} // namespace nsrd
 
+template <typename T, std::size_t CAPACITY>
+class WaitableQueue<T, MPMCRing<T, CAPACITY> >
+{
+public:
+     WaitableQueue();
+    ~WaitableQueue() = default;
+
+    WaitableQueue(WaitableQueue &other) = delete;
+    WaitableQueue(WaitableQueue &&other) = delete;
+    WaitableQueue &operator=(WaitableQueue &other) = delete;
+    WaitableQueue &operator=(WaitableQueue &&other) = delete;
+
+    void Push(const T& data);
+    void Push(T&& data);
+    template <typename... ARGS>
+    void Emplace(ARGS&&... args);
+    bool TryPush(const T& data);
+    bool TryPush(T&& data);
+    template <typename ITERATOR>
+    void PushRange(ITERATOR first, ITERATOR last);
+    void Pop(T &dest);
+    bool Pop(T &dest, nanoseconds timeout);
+    bool Pop(T &dest, std::chrono::steady_clock::time_point deadline);
+    template <typename OUTPUT_ITERATOR>
+    std::size_t PopUpTo(OUTPUT_ITERATOR dest, std::size_t n);
+    template <typename OUTPUT_ITERATOR>
+    std::size_t PopUpTo(OUTPUT_ITERATOR dest, std::size_t n, nanoseconds timeout);
+    bool IsEmpty() const;
+
+private:
+    static const std::size_t MIN_SPINS = 16;
+    static const std::size_t MAX_SPINS = 4096;
+
+    MPMCRing<T, CAPACITY> m_ring;
+    FutexEvent m_pushed; // popping threads sleep on it
+    FutexEvent m_popped; // pushing threads sleep on it while the ring is full
+    std::atomic<std::size_t> m_spins;
+
+    bool SpinPop(T &dest);
+};
+
+template<class T, std::size_t CAPACITY>
+const std::size_t WaitableQueue<T, MPMCRing<T, CAPACITY> >::MIN_SPINS;
+
+template<class T, std::size_t CAPACITY>
+const std::size_t WaitableQueue<T, MPMCRing<T, CAPACITY> >::MAX_SPINS;
+
+template<class T, std::size_t CAPACITY>
+WaitableQueue<T, MPMCRing<T, CAPACITY> >::WaitableQueue()
+    : m_ring(), m_pushed(), m_popped(), m_spins(MIN_SPINS * 4)
+{}
+
+template<class T, std::size_t CAPACITY>
+bool WaitableQueue<T, MPMCRing<T, CAPACITY> >::TryPush(const T &data)
+{
+    if (!m_ring.TryPush(data))
+    {
+        return (false);
+    }
+
+    m_pushed.Notify();
+
+    return (true);
+}
+
+template<class T, std::size_t CAPACITY>
+void WaitableQueue<T, MPMCRing<T, CAPACITY> >::Push(const T &data)
+{
+    while (!TryPush(data))
+    {
+        uint32_t epoch = m_popped.Prepare();
+        if (TryPush(data))
+        {
+            m_popped.Cancel();
+            return;
+        }
+
+        m_popped.Wait(epoch);
+    }
+}
+
+template<class T, std::size_t CAPACITY>
+bool WaitableQueue<T, MPMCRing<T, CAPACITY> >::TryPush(T &&data)
+{
+    if (!m_ring.TryPush(std::move(data)))
+    {
+        return (false);
+    }
+
+    m_pushed.Notify();
+
+    return (true);
+}
+
+template<class T, std::size_t CAPACITY>
+void WaitableQueue<T, MPMCRing<T, CAPACITY> >::Push(T &&data)
+{
+    while (!TryPush(std::move(data)))
+    {
+        uint32_t epoch = m_popped.Prepare();
+        if (TryPush(std::move(data)))
+        {
+            m_popped.Cancel();
+            return;
+        }
+
+        m_popped.Wait(epoch);
+    }
+}
+
+template<class T, std::size_t CAPACITY>
+template<typename... ARGS>
+void WaitableQueue<T, MPMCRing<T, CAPACITY> >::Emplace(ARGS&&... args)
+{
+    Push(T(std::forward<ARGS>(args)...));
+}
+
+template<class T, std::size_t CAPACITY>
+template<typename ITERATOR>
+void WaitableQueue<T, MPMCRing<T, CAPACITY> >::PushRange(ITERATOR first, ITERATOR last)
+{
+    std::size_t pushed = 0;
+
+    for (; first != last; ++first)
+    {
+        if (m_ring.TryPush(*first))
+        {
+            ++pushed;
+            continue;
+        }
+
+        // the ring is full, the consumers must hear of what was pushed so far
+        // before waiting for them
+        if (0 < pushed)
+        {
+            m_pushed.Notify(INT_MAX);
+            pushed = 0;
+        }
+        Push(*first);
+    }
+
+    if (0 < pushed)
+    {
+        m_pushed.Notify(1 == pushed ? 1 : INT_MAX);
+    }
+}
+
+template<class T, std::size_t CAPACITY>
+void WaitableQueue<T, MPMCRing<T, CAPACITY> >::Pop(T &dest)
+{
+    if (SpinPop(dest))
+    {
+        return;
+    }
+
+    while (true)
+    {
+        uint32_t epoch = m_pushed.Prepare();
+        if (m_ring.TryPop(dest))
+        {
+            m_pushed.Cancel();
+            m_popped.Notify();
+            return;
+        }
+
+        m_pushed.Wait(epoch);
+    }
+}
+
+template<class T, std::size_t CAPACITY>
+bool WaitableQueue<T, MPMCRing<T, CAPACITY> >::Pop(T &dest, nanoseconds timeout)
+{
+    return (Pop(dest, std::chrono::steady_clock::now() + timeout));
+}
+
+template<class T, std::size_t CAPACITY>
+bool WaitableQueue<T, MPMCRing<T, CAPACITY> >::Pop(T &dest,
+                                                   std::chrono::steady_clock::time_point deadline)
+{
+    if (m_ring.TryPop(dest))
+    {
+        m_popped.Notify();
+        return (true);
+    }
+
+    // a zero timeout is a plain try, not worth a spin
+    if (std::chrono::steady_clock::now() >= deadline)
+    {
+        return (false);
+    }
+
+    if (SpinPop(dest))
+    {
+        return (true);
+    }
+
+    while (true)
+    {
+        uint32_t epoch = m_pushed.Prepare();
+        if (m_ring.TryPop(dest))
+        {
+            m_pushed.Cancel();
+            m_popped.Notify();
+            return (true);
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            m_pushed.Cancel();
+            return (false);
+        }
+
+        m_pushed.Wait(epoch, deadline);
+    }
+}
+
+template<class T, std::size_t CAPACITY>
+template<typename OUTPUT_ITERATOR>
+std::size_t WaitableQueue<T, MPMCRing<T, CAPACITY> >::PopUpTo(OUTPUT_ITERATOR dest, std::size_t n)
+{
+    if (0 == n)
+    {
+        return (0);
+    }
+
+    T value;
+    Pop(value);
+    *dest = std::move(value);
+    ++dest;
+
+    std::size_t popped = 1;
+    for (; popped < n && m_ring.TryPop(value); ++popped, ++dest)
+    {
+        *dest = std::move(value);
+    }
+
+    if (1 < popped)
+    {
+        m_popped.Notify(INT_MAX);
+    }
+
+    return (popped);
+}
+
+template<class T, std::size_t CAPACITY>
+template<typename OUTPUT_ITERATOR>
+std::size_t WaitableQueue<T, MPMCRing<T, CAPACITY> >::PopUpTo(OUTPUT_ITERATOR dest, std::size_t n,
+                                                              nanoseconds timeout)
+{
+    T value;
+    if (0 == n || !Pop(value, timeout))
+    {
+        return (0);
+    }
+    *dest = std::move(value);
+    ++dest;
+
+    std::size_t popped = 1;
+    for (; popped < n && m_ring.TryPop(value); ++popped, ++dest)
+    {
+        *dest = std::move(value);
+    }
+
+    if (1 < popped)
+    {
+        m_popped.Notify(INT_MAX);
+    }
+
+    return (popped);
+}
+
+template<class T, std::size_t CAPACITY>
+bool WaitableQueue<T, MPMCRing<T, CAPACITY> >::IsEmpty() const
+{
+    return (m_ring.IsEmpty());
+}
+
+template<class T, std::size_t CAPACITY>
+bool WaitableQueue<T, MPMCRing<T, CAPACITY> >::SpinPop(T &dest)
+{
+    std::size_t spins = m_spins.load(std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < spins; ++i)
+    {
+        if (m_ring.TryPop(dest))
+        {
+            if (0 < i)
+            {
+                m_spins.store(std::min(spins * 2, MAX_SPINS), std::memory_order_relaxed);
+            }
+            m_popped.Notify();
+
+            return (true);
+        }
+
+        CpuRelax();
+    }
+
+    m_spins.store(std::max(spins / 2, MIN_SPINS), std::memory_order_relaxed);
+
+    return (false);
+}
+} // namespace nsrd
 
 #endif // NSRD_WAITABLE_QUEUE_HPP
\ No newline at end of file
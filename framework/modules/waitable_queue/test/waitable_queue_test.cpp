@@ -11,6 +11,9 @@
 #include <queue> // std::queue
 #include <thread> // std::thread
 #include <chrono> // std::chrono
+#include <vector> // std::vector
+#include <atomic> // std::atomic
+#include <iterator> // std::back_inserter
 
 #include "testing.hpp" // nsrd::testing::Testscmp, nsrd::testing::UnitTest
 #include "waitable_queue.hpp" // nsrd::WaitableQueue
@@ -21,6 +24,10 @@ using namespace nsrd::testing;
 namespace tests
 {
 void TestGeneral(void);
+void TestDeadline(void);
+void TestRing(void);
+void TestRingThreads(void);
+void TestRange(void);
 } // namespace tests
 
 int main()
@@ -28,6 +35,10 @@ int main()
     Testscmp cmp;
 
     cmp.AddTest(UnitTest("General", tests::TestGeneral));
+    cmp.AddTest(UnitTest("Deadline", tests::TestDeadline));
+    cmp.AddTest(UnitTest("Lock-free ring", tests::TestRing));
+    cmp.AddTest(UnitTest("Lock-free ring threads", tests::TestRingThreads));
+    cmp.AddTest(UnitTest("Range", tests::TestRange));
     cmp.Run();
 
     return (0);
@@ -82,4 +93,184 @@ void TestGeneral(void)
     Consumer3.join();
 }
 
+void TestDeadline(void)
+{
+    using std::chrono::steady_clock;
+    using std::chrono::milliseconds;
+
+    WaitableQueue<int> wq;
+    int val = 0;
+
+    steady_clock::time_point deadline = steady_clock::now() + milliseconds(100);
+    TH_ASSERT(false == wq.Pop(val, deadline));
+    TH_ASSERT(steady_clock::now() >= deadline);
+
+    TH_ASSERT(false == wq.Pop(val, milliseconds(50)));
+
+    wq.Push(42);
+    TH_ASSERT(true == wq.Pop(val, steady_clock::now() + milliseconds(100)));
+    TH_ASSERT(42 == val);
+}
+
+void TestRing(void)
+{
+    using std::chrono::steady_clock;
+    using std::chrono::milliseconds;
+
+    WaitableQueue<int, MPMCRing<int, 4> > wq;
+    int val = 0;
+
+    TH_ASSERT(true == wq.IsEmpty());
+    TH_ASSERT(false == wq.Pop(val, milliseconds(0)));
+
+    steady_clock::time_point deadline = steady_clock::now() + milliseconds(100);
+    TH_ASSERT(false == wq.Pop(val, deadline));
+    TH_ASSERT(steady_clock::now() >= deadline);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        TH_ASSERT(true == wq.TryPush(i));
+    }
+    TH_ASSERT(false == wq.TryPush(4));
+    TH_ASSERT(false == wq.IsEmpty());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        TH_ASSERT(true == wq.Pop(val, milliseconds(0)));
+        TH_ASSERT(i == val);
+    }
+    TH_ASSERT(true == wq.IsEmpty());
+
+    // a full ring makes Push wait for a pop
+    for (int i = 0; i < 4; ++i)
+    {
+        wq.Push(i);
+    }
+    std::thread popper([&wq]()
+    {
+        int popped = 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        wq.Pop(popped);
+    });
+    wq.Push(4);
+    popper.join();
+
+    for (int i = 1; i < 5; ++i)
+    {
+        wq.Pop(val);
+        TH_ASSERT(i == val);
+    }
+}
+
+void TestRingThreads(void)
+{
+    const int PER_PRODUCER = 100000;
+    const std::size_t PRODUCERS = 4;
+    const std::size_t CONSUMERS = 4;
+
+    WaitableQueue<int, MPMCRing<int, 64> > wq;
+    std::atomic<long> sum(0);
+    std::atomic<long> count(0);
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 0; i < CONSUMERS; ++i)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            int val = 0;
+            while (true)
+            {
+                wq.Pop(val);
+                if (-1 == val)
+                {
+                    break;
+                }
+                sum += val;
+                ++count;
+            }
+        }));
+    }
+
+    std::vector<std::thread> producers;
+    for (std::size_t i = 0; i < PRODUCERS; ++i)
+    {
+        producers.push_back(std::thread([&]()
+        {
+            for (int val = 1; val <= PER_PRODUCER; ++val)
+            {
+                wq.Push(val);
+            }
+        }));
+    }
+
+    for (auto &producer : producers)
+    {
+        producer.join();
+    }
+    for (std::size_t i = 0; i < CONSUMERS; ++i)
+    {
+        wq.Push(-1);
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    long expected = static_cast<long>(PER_PRODUCER) * (PER_PRODUCER + 1) / 2 * PRODUCERS;
+    TH_ASSERT(static_cast<long>(PER_PRODUCER * PRODUCERS) == count);
+    TH_ASSERT(expected == sum);
+    TH_ASSERT(true == wq.IsEmpty());
+}
+
+template <typename QUEUE>
+void TestRangeOf(QUEUE &wq)
+{
+    std::vector<int> values = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    int popped[10] = {0};
+
+    TH_ASSERT(0 == wq.PopUpTo(popped, 4, std::chrono::milliseconds(10)));
+
+    wq.PushRange(values.begin(), values.end());
+    TH_ASSERT(4 == wq.PopUpTo(popped, 4));
+    TH_ASSERT(6 == wq.PopUpTo(popped + 4, 100, std::chrono::milliseconds(10)));
+    TH_ASSERT(true == wq.IsEmpty());
+
+    for (int i = 0; i < 10; ++i)
+    {
+        TH_ASSERT(i == popped[i]);
+    }
+
+    // every waiting consumer is woken up by a range
+    std::atomic<int> consumed(0);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 3; ++i)
+    {
+        consumers.push_back(std::thread([&wq, &consumed]()
+        {
+            std::vector<int> got;
+            if (0 < wq.PopUpTo(std::back_inserter(got), 1, std::chrono::seconds(5)))
+            {
+                ++consumed;
+            }
+        }));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    wq.PushRange(values.begin(), values.begin() + 3);
+
+    for (auto &consumer : consumers)
+    {
+        consumer.join();
+    }
+    TH_ASSERT(3 == consumed);
+}
+
+void TestRange(void)
+{
+    WaitableQueue<int> wq;
+    TestRangeOf(wq);
+
+    WaitableQueue<int, MPMCRing<int, 16> > ring_wq;
+    TestRangeOf(ring_wq);
+}
 } // namespace tests
@@ -8,39 +8,57 @@
 * 
 *******************************************************************************/
 
+#include <thread> // std::thread
+#include <algorithm> // std::max
+#include <string> // std::to_string
+
 #include "framework.hpp" // nsrd::Framework
 
 using namespace nsrd;
 
-Framework::Framework(const std::string &plugin_dir_path)
-    : m_fd_monitor(),
-      m_th_pool(),
+const std::size_t Framework::ANY_LOOP;
+const std::size_t Framework::MAX_THREADS_PER_CORE;
+
+Framework::Framework(const std::string &plugin_dir_path, std::size_t loops_num)
+    : m_loop_placement(1 < loops_num ? Placement::PER_CPU : Placement::UNPINNED),
+      m_fd_monitors(),
+      m_th_pools(),
+      m_scalers(),
+      m_strands(),
+      m_handler_loops(),
+      m_handler_loops_mutex(),
       m_commands_factory(Handleton<framework_factory_t>::GetInstance()),
       m_plugins_dir_monitor(plugin_dir_path),
       m_plugins_loader(),
       m_logger(Handleton<Logger>::GetInstance()),
-      m_run(false),
-      m_stop_fd_monitor_pipe()
+      m_run(false)
 {
-    m_plugins_dir_monitor.AttachSub(m_plugins_loader.GetCallback());
-    m_plugins_dir_monitor.Start();
-    m_logger->Info("Framework has been created");
+    loops_num = std::max(loops_num, std::size_t(1));
+    std::size_t cores_per_loop = std::max(std::thread::hardware_concurrency() / loops_num,
+                                          std::size_t(1));
 
-    if (-1 == pipe(m_stop_fd_monitor_pipe))
+    for (std::size_t i = 0; i < loops_num; ++i)
     {
-        m_logger->Error("Couldn't open closing pipe");
-        throw::std::runtime_error("Couldn't open closing pipe");
+        m_fd_monitors.emplace_back(new Reactor(Listener::EPOLL));
+        // the workers stay on the node of their loop, and its memory
+        Placement workers_placement = 1 < loops_num ?
+            Placement(Placement::PER_NODE, m_loop_placement.GetNodeCpus(i)) : Placement();
+        m_th_pools.emplace_back(new ThreadPool(1, ThreadPool::WORK_STEALING, 0,
+                                               workers_placement));
+        m_scalers.emplace_back(new AutoScaler(*m_th_pools.back(), 1,
+                                              cores_per_loop * MAX_THREADS_PER_CORE));
+        m_strands.emplace_back(new Strands(*m_th_pools.back(), ThreadPool::Priority::MEDIUM));
     }
 
-    SetUpDefHandlers();
+    m_plugins_dir_monitor.AttachSub(m_plugins_loader.GetCallback());
+    m_plugins_dir_monitor.Start();
+    m_logger->Info("Framework has been created");
 }
 
 Framework::~Framework() noexcept
 {
     Stop();
     m_plugins_dir_monitor.Stop();
-    close(m_stop_fd_monitor_pipe[READ_END]);
-    close(m_stop_fd_monitor_pipe[WRITE_END]);
     m_logger->Info("Framework destroying");
 }
 
@@ -50,52 +68,70 @@ void Framework::Run()
     {
         m_run = true;
         m_logger->Info("Starting the framework");
-        m_fd_monitor.Run();
-    }
-}
 
-void Framework::Stop()
-{
-    if (m_run)
-    {
-        m_run = false;
-        m_logger->Info("Stopping the framework");
-        if (-1 == write(m_stop_fd_monitor_pipe[WRITE_END], "", 1))
+        if (1 == m_fd_monitors.size())
+        {
+            m_fd_monitors[0]->Run();
+            return;
+        }
+
+        std::vector<std::thread> loops;
+
+        for (std::size_t i = 0; i < m_fd_monitors.size(); ++i)
+        {
+            loops.emplace_back(&Framework::RunLoop, this, i);
+        }
+
+        for (auto &loop : loops)
         {
-            m_logger->Error("Got error stopping monitor");
+            loop.join();
         }
     }
 }
 
-void Framework::SetUpDefHandlers()
+void Framework::RunLoop(std::size_t loop)
 {
-    m_fd_monitor.Add(m_stop_fd_monitor_pipe[READ_END],
-                    std::bind(&Framework::StopFdMonitorHandler, this),
-                    SocketEventType::READ);
+    if (!m_loop_placement.Apply(loop))
+    {
+        m_logger->Warn("Couldn't place event loop " + std::to_string(loop));
+    }
+
+    try
+    {
+        m_fd_monitors[loop]->Run();
+    }
+    catch (const std::exception &e)
+    {
+        m_logger->Error(std::string("Event loop failed: ") + e.what());
+        Stop();
+    }
 }
 
-void Framework::StopFdMonitorHandler()
+void Framework::Stop()
 {
-    char buf[1];
-    if (-1 == read(m_stop_fd_monitor_pipe[READ_END], buf, 1))
+    if (m_run)
     {
-        m_logger->Error("Reading closing pipe");
-    }
+        m_run = false;
+        m_logger->Info("Stopping the framework");
 
-    m_fd_monitor.Stop();
+        for (auto &fd_monitor : m_fd_monitors)
+        {
+            fd_monitor->Post(std::bind(&Reactor::Stop, fd_monitor.get()));
+        }
+    }
 }
 
-class CommandTask : public Task
+// move-only, it fits in a UniqueTask and owns the command alone
+class CommandTask
 {
 public:
-    explicit CommandTask(std::shared_ptr<ICommand> command);
-    ~CommandTask() = default;
+    explicit CommandTask(ICommand *command) noexcept;
     void operator()();
 private:
-    std::shared_ptr<ICommand> m_concrete_command;
+    std::unique_ptr<ICommand> m_concrete_command;
 };
 
-CommandTask::CommandTask(std::shared_ptr<ICommand> command)
+CommandTask::CommandTask(ICommand *command) noexcept
     : m_concrete_command(command)
 {}
 
@@ -104,24 +140,78 @@ void CommandTask::operator()()
     (*m_concrete_command)();
 }
 
-void Framework::AddSocketHandler(int fd, SocketEventType type, const socket_handler_t &handler)
+void Framework::AddSocketHandler(int fd, SocketEventType type, const socket_handler_t &handler,
+                                 std::size_t loop)
 {
-    Stop();
+    loop = RegisterHandler(fd, type, loop);
+    ThreadPool *th_pool = m_th_pools[loop].get();
 
-    auto handler_wrapper = [fd, handler, this]()
+    auto handler_wrapper = [fd, handler, th_pool, this]()
     {
         std::pair<builder_id_t, ICommandParams * > p = handler(fd);
-        std::shared_ptr<ICommand> concrete_command(m_commands_factory->Create(p.first, p.second));
-        std::shared_ptr<CommandTask> command_task(new CommandTask(concrete_command));
-        m_th_pool.Add(command_task, ThreadPool::Priority::MEDIUM);
+        if (!p.second)
+        {
+            return; // the handler has no complete request yet
+        }
+
+        th_pool->Add(CommandTask(m_commands_factory->Create(p.first, p.second)),
+                     ThreadPool::Priority::MEDIUM);
     };
-    
-    m_fd_monitor.Add(fd, handler_wrapper, type);
+
+    m_fd_monitors[loop]->Add(fd, handler_wrapper, type);
+}
+
+void Framework::AddOrderedSocketHandler(int fd, SocketEventType type,
+                                        const ordered_socket_handler_t &handler,
+                                        std::size_t loop)
+{
+    loop = RegisterHandler(fd, type, loop);
+    Strands *strands = m_strands[loop].get();
+
+    auto handler_wrapper = [fd, handler, strands, this]()
+    {
+        std::tuple<builder_id_t, ICommandParams *, order_key_t, std::size_t> t = handler(fd);
+        if (!std::get<1>(t))
+        {
+            return; // the handler has no complete request yet
+        }
+
+        strands->Add(std::get<2>(t), std::get<3>(t),
+                     CommandTask(m_commands_factory->Create(std::get<0>(t), std::get<1>(t))));
+    };
+
+    m_fd_monitors[loop]->Add(fd, handler_wrapper, type);
+}
+
+std::size_t Framework::RegisterHandler(int fd, SocketEventType type, std::size_t loop)
+{
+    if (ANY_LOOP == loop)
+    {
+        loop = static_cast<std::size_t>(fd) % m_fd_monitors.size();
+    }
+    loop %= m_fd_monitors.size();
+
+    std::unique_lock<std::mutex> lock(m_handler_loops_mutex);
+    m_handler_loops[{fd, type}] = loop;
+
+    return (loop);
 }
 
 void Framework::RemoveSocketHandler(int fd, SocketEventType type)
 {
-    Stop();
-    
-    m_fd_monitor.Remove(fd, type);
+    std::size_t loop = 0;
+    {
+        std::unique_lock<std::mutex> lock(m_handler_loops_mutex);
+
+        auto found = m_handler_loops.find({fd, type});
+        if (m_handler_loops.end() == found)
+        {
+            return;
+        }
+
+        loop = found->second;
+        m_handler_loops.erase(found);
+    }
+
+    m_fd_monitors[loop]->Remove(fd, type);
 }
\ No newline at end of file